@@ -4,15 +4,56 @@
 #include <cstdlib>
 #include <ctime>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <memory_resource>
+#include <new>
+#include <climits>
+#include <cctype>
+#include <mutex>
+#include <condition_variable>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "rlgl.h"
 #ifndef PLATFORM_WEB
 #include "favicon.h"
 #endif
+#if !defined(PLATFORM_WEB) && !defined(_WIN32)
+#define ZAYDROIDS_NET 1
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <cerrno>
+#endif
 #if defined(PLATFORM_WEB)
 #include <emscripten/emscripten.h>
 #endif
 #ifdef __EMSCRIPTEN__
+#include <emscripten/emscripten.h>
 #include <emscripten/html5.h>
 #endif
+#if !defined(PLATFORM_WEB) && !defined(_WIN32)
+#define ZAYDROIDS_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+// Threads work everywhere except a web build linked without -pthread.
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define ZAYDROIDS_THREADS 1
+#endif
 
 // --------------------------------------------------
 // Constants
@@ -33,8 +74,161 @@ const float BULLET_COOLDOWN = 0.18f;
 
 const float ASTEROID_BASE_SPEED = 40.0f;
 
+const int ASTEROID_MAX_POINTS = 14;
+
+// Per-size asteroid constants, indexed by size (1 small .. 3 large).
+constexpr float ASTEROID_RADIUS[4] = {0, 14.0f, 26.0f, 42.0f};
+constexpr int ASTEROID_SCORE[4] = {0, 10, 20, 30};
+constexpr float ASTEROID_SPEED_BONUS[4] = {0, 40.0f, 20.0f, 0.0f};
+// For --bounce: proportional to area, as seen from above.
+constexpr float ASTEROID_MASS[4] = {0, 14.0f * 14.0f, 26.0f * 26.0f, 42.0f * 42.0f};
+
 const int LIVES_START = 3;
 
+// Frames longer than this (window dragged, tab throttled, debugger) are
+// simulated as this long instead of teleporting everything.
+const float MAX_FRAME_DT = 0.1f;
+
+// Simulation LOD. Bullets can end up at most
+// (BULLET_SPEED + 2 * SHIP_MAX_SPEED) * BULLET_LIFETIME ~ 1490 px from the
+// ship, so anything inside LOD_ACTIVE_RADIUS must be exact; beyond it
+// asteroids may lag by a few ticks. The closing speed bounds how fast a
+// lagging asteroid and the ship can approach each other.
+const float LOD_ACTIVE_RADIUS = 1600.0f;
+const float LOD_MAX_CLOSING_SPEED = SHIP_MAX_SPEED + ASTEROID_BASE_SPEED + 80.0f;
+
+// Size of the wrapping playfield. Defaults to one screen; `--world WxH`
+// makes it larger and the camera then follows the ship.
+float worldWidth = SCREEN_WIDTH;
+float worldHeight = SCREEN_HEIGHT;
+
+// --------------------------------------------------
+// Frame arena
+// --------------------------------------------------
+
+// Scratch memory for data that lives for one frame (or one headless tick):
+// collision results, split fragments, spawn placement. It is bump-allocated
+// from a fixed block and dropped wholesale by Reset() at the top of the
+// frame. A frame that outgrows the block spills to the heap until the next
+// reset.
+const size_t FRAME_ARENA_BYTES = 4 << 20;
+
+struct FrameArena
+{
+    std::unique_ptr<unsigned char[]> block;
+    std::pmr::monotonic_buffer_resource resource;
+
+    FrameArena()
+        : block(new unsigned char[FRAME_ARENA_BYTES]),
+          resource(block.get(), FRAME_ARENA_BYTES) {}
+
+    void Reset() { resource.release(); }
+};
+
+// One per thread, so headless sims on worker threads get their own.
+thread_local FrameArena frameArena;
+
+// Build with -DZAYDROIDS_COUNT_ALLOCS to count every global operator new,
+// e.g. to check that steady-state frames don't touch the heap.
+#ifdef ZAYDROIDS_COUNT_ALLOCS
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC can't tell these replacements pair malloc with free.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+std::atomic<uint64_t> heapAllocations{0};
+
+void *operator new(size_t n)
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+#endif
+
+uint64_t HeapAllocations()
+{
+#ifdef ZAYDROIDS_COUNT_ALLOCS
+    return heapAllocations.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+// --------------------------------------------------
+// Fast math
+// --------------------------------------------------
+
+// Sine and cosine from libm with one shared range reduction.
+void SinCos(float a, float *s, float *c)
+{
+#if defined(__GLIBC__)
+    sincosf(a, s, c);
+#else
+    *s = sinf(a);
+    *c = cosf(a);
+#endif
+}
+
+// Polynomial sine and cosine for cosmetic work (particles, asteroid
+// outlines) where libm's last bits don't matter. The angle is reduced by
+// quarter turns (pi/2 split in three parts so the products are exact) and
+// the cephes minimax polynomials are evaluated on [-pi/4, pi/4]. Unlike
+// libm it is the same IEEE float arithmetic everywhere, so outlines rebuilt
+// from a snapshot's shape seed match the sender's exactly - provided no
+// compiler fuses a multiply and add into an FMA, which rounds once instead
+// of twice. GCC and Clang do by default where FMA exists, so contraction
+// is switched off for this function. Max
+// absolute error against double-precision sin/cos is under 2e-7 for
+// |a| <= 1000 and 2e-6 up to 1e5; --bench fastmath checks both bounds.
+const float FAST_TWO_OVER_PI = 0.636619772f;
+const float FAST_PI_2_HI = 1.5703125f;
+const float FAST_PI_2_MID = 4.837512969970703125e-4f;
+const float FAST_PI_2_LO = 7.54978995489188216e-8f;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#pragma fp_contract(off)
+#endif
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("fp-contract=off")))
+#endif
+void FastSinCos(float a, float *s, float *c)
+{
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#endif
+    // Round to the nearest quarter turn by adding and removing 1.5 * 2^23
+    // (valid for |a| < 6e6), keeping the whole function branch-free.
+    float r = (a * FAST_TWO_OVER_PI + 12582912.0f) - 12582912.0f;
+    uint32_t k = (uint32_t)(int32_t)r;
+    r = ((a - r * FAST_PI_2_HI) - r * FAST_PI_2_MID) - r * FAST_PI_2_LO;
+
+    float z = r * r;
+    float sr = r + r * z * (-1.6666654611e-1f + z * (8.3321608736e-3f + z * -1.9515295891e-4f));
+    float cr = 1.0f - 0.5f * z + z * z * (4.166664568298827e-2f + z * (-1.388731625493765e-3f + z * 2.443315711809948e-5f));
+
+    // Quadrant fix-up on the bits: odd quadrants swap sine and cosine, and
+    // the sign flips follow k & 2 and (k + 1) & 2.
+    uint32_t sb, cb;
+    memcpy(&sb, &sr, 4);
+    memcpy(&cb, &cr, 4);
+    uint32_t swap = 0u - (k & 1);
+    uint32_t sOut = ((sb & ~swap) | (cb & swap)) ^ ((k & 2) << 30);
+    uint32_t cOut = ((cb & ~swap) | (sb & swap)) ^ (((k + 1) & 2) << 30);
+    memcpy(s, &sOut, 4);
+    memcpy(c, &cOut, 4);
+}
+
+Vector2 FastVecFromAngle(float angle)
+{
+    Vector2 v;
+    FastSinCos(angle, &v.y, &v.x);
+    return v;
+}
+
 // --------------------------------------------------
 // Utility
 // --------------------------------------------------
@@ -42,21 +236,51 @@ const int LIVES_START = 3;
 Vector2 WrapPosition(Vector2 pos)
 {
     if (pos.x < 0)
-        pos.x += SCREEN_WIDTH;
-    else if (pos.x > SCREEN_WIDTH)
-        pos.x -= SCREEN_WIDTH;
+        pos.x += worldWidth;
+    else if (pos.x > worldWidth)
+        pos.x -= worldWidth;
 
     if (pos.y < 0)
-        pos.y += SCREEN_HEIGHT;
-    else if (pos.y > SCREEN_HEIGHT)
-        pos.y -= SCREEN_HEIGHT;
+        pos.y += worldHeight;
+    else if (pos.y > worldHeight)
+        pos.y -= worldHeight;
 
     return pos;
 }
 
+double NowSeconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
 Vector2 VecFromAngle(float angle)
 {
-    return {cosf(angle), sinf(angle)};
+    Vector2 v;
+    SinCos(angle, &v.y, &v.x);
+    return v;
+}
+
+// `v` turned by an angle given as its cosine and sine.
+Vector2 VecRotate(Vector2 v, float c, float s)
+{
+    return {v.x * c - v.y * s, v.x * s + v.y * c};
+}
+
+// Shortest displacement from `from` to `to` on the wrapping world.
+Vector2 WrapDelta(Vector2 from, Vector2 to)
+{
+    float dx = to.x - from.x;
+    float dy = to.y - from.y;
+    if (dx > worldWidth / 2)
+        dx -= worldWidth;
+    else if (dx < -worldWidth / 2)
+        dx += worldWidth;
+    if (dy > worldHeight / 2)
+        dy -= worldHeight;
+    else if (dy < -worldHeight / 2)
+        dy += worldHeight;
+    return {dx, dy};
 }
 
 float VecLen(Vector2 v)
@@ -92,18 +316,339 @@ bool CircleCollision(Vector2 p1, float r1, Vector2 p2, float r2)
     return (dx * dx + dy * dy) <= (r1 + r2) * (r1 + r2);
 }
 
+// Game-wide xorshift32 state. Kept as plain data (instead of rand()) so a
+// snapshot can capture it and a restored game continues identically.
+uint32_t rngState = 0x9E3779B9u;
+
+void SeedRandom(uint32_t seed)
+{
+    rngState = seed ? seed : 0x9E3779B9u;
+}
+
+uint32_t NextRandom(uint32_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+uint32_t RandomU32()
+{
+    return NextRandom(rngState);
+}
+
 float RandomRange(float min, float max)
 {
-    return min + (float)rand() / (float)RAND_MAX * (max - min);
+    return min + (float)(RandomU32() >> 8) / 16777216.0f * (max - min);
 }
 
 Vector2 RandomAsteroidVelocity(int size)
 {
     float angle = RandomRange(0, PI * 2);
-    float speed = ASTEROID_BASE_SPEED + RandomRange(0, 40) + (3 - size) * 20;
+    float speed = ASTEROID_BASE_SPEED + RandomRange(0, 40) + ASTEROID_SPEED_BONUS[size];
     return VecScale(VecFromAngle(angle), speed);
 }
 
+// Spreads `count` points over the world on a jittered grid, one per cell,
+// keeping them at least `clearance` away from `avoid`. A point that lands
+// inside the clearance disk is pushed out to its edge, so placement is
+// O(count) with no retry loop however crowded the world gets.
+void PlaceStratified(int count, Vector2 avoid, float clearance, std::pmr::vector<Vector2> &out)
+{
+    out.clear();
+    if (count <= 0)
+        return;
+
+    int cols = (int)ceilf(sqrtf(count * worldWidth / worldHeight));
+    int rows = (count + cols - 1) / cols;
+    float cellW = worldWidth / cols;
+    float cellH = worldHeight / rows;
+
+    // Partial Fisher-Yates picks `count` distinct cells.
+    std::pmr::vector<int> cells(cols * rows, out.get_allocator());
+    for (int i = 0; i < (int)cells.size(); i++)
+        cells[i] = i;
+
+    for (int i = 0; i < count; i++)
+    {
+        int j = i + (int)(RandomU32() % (uint32_t)(cells.size() - i));
+        std::swap(cells[i], cells[j]);
+        int cx = cells[i] % cols;
+        int cy = cells[i] / cols;
+
+        Vector2 p = {(cx + RandomRange(0, 1)) * cellW, (cy + RandomRange(0, 1)) * cellH};
+        Vector2 d = {p.x - avoid.x, p.y - avoid.y};
+        float len = VecLen(d);
+        if (len < clearance)
+        {
+            Vector2 dir = len > 0.001f ? VecScale(d, 1.0f / len) : VecFromAngle(RandomRange(0, PI * 2));
+            p = WrapPosition(VecAdd(avoid, VecScale(dir, clearance)));
+        }
+        out.push_back(p);
+    }
+}
+
+// --------------------------------------------------
+// View
+// --------------------------------------------------
+
+// The part of the torus that is on screen. Draw code asks it for the copy of
+// an entity (shifted by whole world sizes) closest to the view, and skips
+// anything that copy doesn't reach.
+struct View
+{
+    Vector2 center;
+    float halfW = SCREEN_WIDTH / 2.0f;
+    float halfH = SCREEN_HEIGHT / 2.0f;
+
+    // Centers on `focus` along axes where the world is bigger than the
+    // screen; smaller axes stay fixed on the world center.
+    static View Follow(Vector2 focus)
+    {
+        View v;
+        v.center.x = worldWidth > SCREEN_WIDTH ? focus.x : worldWidth / 2;
+        v.center.y = worldHeight > SCREEN_HEIGHT ? focus.y : worldHeight / 2;
+        return v;
+    }
+
+    Vector2 Nearest(Vector2 p) const
+    {
+        float dx = p.x - center.x;
+        float dy = p.y - center.y;
+        if (dx > worldWidth / 2)
+            p.x -= worldWidth;
+        else if (dx < -worldWidth / 2)
+            p.x += worldWidth;
+        if (dy > worldHeight / 2)
+            p.y -= worldHeight;
+        else if (dy < -worldHeight / 2)
+            p.y += worldHeight;
+        return p;
+    }
+
+    bool Visible(Vector2 p, float radius) const
+    {
+        return fabsf(p.x - center.x) <= halfW + radius &&
+               fabsf(p.y - center.y) <= halfH + radius;
+    }
+
+    Camera2D Camera() const
+    {
+        Camera2D cam = {};
+        cam.offset = {halfW, halfH};
+        cam.target = center;
+        cam.zoom = 1.0f;
+        return cam;
+    }
+};
+
+// --------------------------------------------------
+// Slot map
+// --------------------------------------------------
+
+// Entity storage that can be referred to across ticks. Items sit densely in
+// `items`, in the order the game relies on, so iterating is iterating a
+// vector. A Handle names a slot plus the generation the slot had when the
+// item went in; the slot maps to the item's current index and its
+// generation moves on when the item is removed, so a handle to a removed
+// item looks up null even after the slot is reused. Lookup is two array
+// reads. Only change `items` through the members below, which keep the
+// slot table in step; editing an item in place is fine.
+template <typename T>
+struct SlotMap
+{
+    struct Handle
+    {
+        uint32_t slot = UINT32_MAX;
+        uint32_t generation = 0;
+
+        bool operator==(const Handle &o) const { return slot == o.slot && generation == o.generation; }
+        bool operator!=(const Handle &o) const { return !(*this == o); }
+    };
+
+    struct Slot
+    {
+        // Index into items while live; the next free slot while free.
+        uint32_t index;
+        uint32_t generation;
+    };
+
+    std::vector<T> items;
+    std::vector<uint32_t> slotOf;
+    std::vector<Slot> slots;
+    uint32_t freeHead = UINT32_MAX;
+
+    // Where Rewrite builds the next order; empty between calls, and kept
+    // only for its capacity.
+    std::vector<T> nextItems;
+    std::vector<uint32_t> nextSlotOf;
+
+    size_t size() const { return items.size(); }
+    bool empty() const { return items.empty(); }
+    T &operator[](size_t i) { return items[i]; }
+    const T &operator[](size_t i) const { return items[i]; }
+    T &back() { return items.back(); }
+    typename std::vector<T>::iterator begin() { return items.begin(); }
+    typename std::vector<T>::iterator end() { return items.end(); }
+    typename std::vector<T>::const_iterator begin() const { return items.begin(); }
+    typename std::vector<T>::const_iterator end() const { return items.end(); }
+
+    void reserve(size_t n)
+    {
+        items.reserve(n);
+        slotOf.reserve(n);
+        slots.reserve(n);
+        nextItems.reserve(n);
+        nextSlotOf.reserve(n);
+    }
+
+    Handle HandleAt(size_t i) const
+    {
+        return {slotOf[i], slots[slotOf[i]].generation};
+    }
+
+    T *Get(Handle h)
+    {
+        if (h.slot >= slots.size() || slots[h.slot].generation != h.generation)
+            return nullptr;
+        return &items[slots[h.slot].index];
+    }
+
+    const T *Get(Handle h) const
+    {
+        return const_cast<SlotMap *>(this)->Get(h);
+    }
+
+    template <typename... A>
+    T &emplace_back(A &&...args)
+    {
+        items.emplace_back(std::forward<A>(args)...);
+        slotOf.push_back(Claim((uint32_t)items.size() - 1));
+        return items.back();
+    }
+
+    void push_back(const T &item)
+    {
+        emplace_back(item);
+    }
+
+    template <typename It>
+    void assign(It first, It last)
+    {
+        clear();
+        for (; first != last; ++first)
+            push_back(*first);
+    }
+
+    void clear()
+    {
+        for (uint32_t slot : slotOf)
+            Release(slot);
+        items.clear();
+        slotOf.clear();
+    }
+
+    // Removes every item pred(item) holds for, keeping the rest in order.
+    template <typename P>
+    void RemoveIf(P &&pred)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            if (pred(items[i]))
+            {
+                Release(slotOf[i]);
+                continue;
+            }
+            if (kept != i)
+            {
+                items[kept] = std::move(items[i]);
+                slotOf[kept] = slotOf[i];
+                slots[slotOf[kept]].index = (uint32_t)kept;
+            }
+            kept++;
+        }
+        items.erase(items.begin() + kept, items.end());
+        slotOf.erase(slotOf.begin() + kept, slotOf.end());
+    }
+
+    // Adds items at the current point of a Rewrite.
+    struct Inserter
+    {
+        SlotMap &map;
+
+        template <typename... A>
+        void emplace_back(A &&...args)
+        {
+            map.nextItems.emplace_back(std::forward<A>(args)...);
+            map.nextSlotOf.push_back(map.Claim((uint32_t)map.nextItems.size() - 1));
+        }
+    };
+
+    // Rebuilds the list in one ordered pass: f(item, out) returns whether
+    // the item stays, and what it adds through `out` goes in just before
+    // it. Items that stay keep their handles.
+    template <typename F>
+    void Rewrite(F &&f)
+    {
+        nextItems.clear();
+        nextSlotOf.clear();
+        Inserter out{*this};
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            if (!f(items[i], out))
+            {
+                Release(slotOf[i]);
+                continue;
+            }
+            slots[slotOf[i]].index = (uint32_t)nextItems.size();
+            nextItems.push_back(std::move(items[i]));
+            nextSlotOf.push_back(slotOf[i]);
+        }
+        items.swap(nextItems);
+        slotOf.swap(nextSlotOf);
+        nextItems.clear();
+        nextSlotOf.clear();
+    }
+
+    void Reverse()
+    {
+        std::reverse(items.begin(), items.end());
+        std::reverse(slotOf.begin(), slotOf.end());
+        for (uint32_t i = 0; i < slotOf.size(); i++)
+            slots[slotOf[i]].index = i;
+    }
+
+    void swap(SlotMap &o)
+    {
+        items.swap(o.items);
+        slotOf.swap(o.slotOf);
+        slots.swap(o.slots);
+        std::swap(freeHead, o.freeHead);
+    }
+
+    uint32_t Claim(uint32_t index)
+    {
+        if (freeHead == UINT32_MAX)
+        {
+            slots.push_back({index, 1});
+            return (uint32_t)slots.size() - 1;
+        }
+        uint32_t slot = freeHead;
+        freeHead = slots[slot].index;
+        slots[slot].index = index;
+        return slot;
+    }
+
+    void Release(uint32_t slot)
+    {
+        slots[slot].generation++;
+        slots[slot].index = freeHead;
+        freeHead = slot;
+    }
+};
+
 // --------------------------------------------------
 // Bullet
 // --------------------------------------------------
@@ -124,9 +669,9 @@ struct Bullet
         life -= dt;
     }
 
-    void Draw() const
+    void Draw(Vector2 at) const
     {
-        DrawCircleV(pos, 2, YELLOW);
+        DrawCircleV(at, 2, YELLOW);
     }
 };
 
@@ -140,25 +685,41 @@ struct Asteroid
     Vector2 vel;
     int size;
     float radius;
-    std::vector<Vector2> points;
+    uint32_t shapeSeed;
+    int pointCount;
+    Vector2 points[ASTEROID_MAX_POINTS];
+
+    // Game time `pos` was last advanced to under simulation LOD; negative
+    // until the first LOD visit.
+    double updatedAt = -1;
 
     Asteroid(Vector2 p, int s) : pos(p), size(s)
     {
-        radius = (s == 3 ? 42 : s == 2 ? 26
-                                       : 14);
+        radius = ASTEROID_RADIUS[s];
         vel = RandomAsteroidVelocity(size);
+        shapeSeed = RandomU32();
+        GenerateShape();
+    }
+
+    // Rebuilds an asteroid from snapshot data; the outline is regenerated
+    // from the seed rather than stored.
+    Asteroid(Vector2 p, Vector2 v, int s, uint32_t seed) : pos(p), vel(v), size(s), shapeSeed(seed)
+    {
+        radius = ASTEROID_RADIUS[s];
         GenerateShape();
     }
 
     void GenerateShape()
     {
-        int count = GetRandomValue(10, 14);
-        points.clear();
-        for (int i = 0; i < count; i++)
+        // Private stream so the outline depends only on shapeSeed.
+        uint32_t state = shapeSeed ? shapeSeed : 1;
+        pointCount = 10 + (int)(NextRandom(state) % (ASTEROID_MAX_POINTS - 9));
+        for (int i = 0; i < pointCount; i++)
         {
-            float angle = (float)i / count * PI * 2;
-            float r = radius * RandomRange(0.7f, 1.1f);
-            points.push_back({cosf(angle) * r, sinf(angle) * r});
+            float angle = (float)i / pointCount * PI * 2;
+            float r = radius * (0.7f + (float)(NextRandom(state) >> 8) / 16777216.0f * 0.4f);
+            Vector2 d = FastVecFromAngle(angle);
+            points[i] = {d.x * r, d.y * r};
         }
     }
 
@@ -168,284 +729,5427 @@ struct Asteroid
         pos = WrapPosition(pos);
     }
 
-    void Draw() const
+    // Where a lagging asteroid really is at game time `now`.
+    Vector2 PositionAt(double now) const
+    {
+        if (updatedAt < 0)
+            return pos;
+        return WrapPosition(VecAdd(pos, VecScale(vel, (float)(now - updatedAt))));
+    }
+
+    void Draw(Vector2 at) const
     {
-        for (size_t i = 0; i < points.size(); i++)
+        for (int i = 0; i < pointCount; i++)
         {
-            Vector2 a = VecAdd(pos, points[i]);
-            Vector2 b = VecAdd(pos, points[(i + 1) % points.size()]);
+            Vector2 a = VecAdd(at, points[i]);
+            Vector2 b = VecAdd(at, points[(i + 1) % pointCount]);
             DrawLineV(a, b, LIGHTGRAY);
         }
     }
 };
 
 // --------------------------------------------------
-// Player
+// Asteroid physics
 // --------------------------------------------------
 
-struct Player
+// Elastic asteroid-asteroid collisions for the --bounce mode. The
+// broadphase is sort and sweep along x, run separately in horizontal bands
+// at least one asteroid diameter tall: two asteroids can only touch if
+// their centres are in the same band or in neighbouring ones, and within a
+// band a pair can only touch if the right one starts before the left one
+// ends. Without the bands every asteroid in the same column would be a
+// candidate and the work would grow with n * sqrt(n) at constant density.
+// Entries stay sorted by (band, left end); asteroids move a few pixels a
+// tick, so last tick's order is nearly sorted and an insertion sort
+// repairs it in about O(n). Extents running past the right edge carry on
+// from the start of the band shifted by the world width, and the y seam is
+// just band 0 neighbouring the last band.
+struct AsteroidSweep
 {
-    Vector2 pos;
-    Vector2 vel;
-    float angle;
-    float cooldown;
-    float invuln;
-    bool alive;
+    static constexpr float SPAN = 2 * ASTEROID_RADIUS[3];
 
-    Player()
+    struct Entry
     {
-        Reset();
-    }
+        float minX, maxX;
+        uint32_t band;
+        uint32_t index;
+    };
+    std::vector<Entry> order;
+    std::vector<uint32_t> bandStart;
+    float bandHeight = 0;
 
-    void Reset()
+    // From the last Resolve.
+    size_t swaps = 0;
+    size_t tested = 0;
+    size_t contacts = 0;
+
+    // Ties go by index, so the order (and with it the order pairs are
+    // resolved in) depends only on the current state, never on history.
+    static bool Before(const Entry &a, const Entry &b)
     {
-        pos = {SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f};
-        vel = {0, 0};
-        angle = -PI / 2;
-        cooldown = 0;
-        invuln = 2.0f;
-        alive = true;
+        if (a.band != b.band)
+            return a.band < b.band;
+        return a.minX < b.minX || (a.minX == b.minX && a.index < b.index);
     }
 
-    void Update(float dt)
+    void Sort(const SlotMap<Asteroid> &asteroids)
     {
-        if (IsKeyDown(KEY_LEFT) || IsKeyDown(KEY_A))
-            angle -= SHIP_TURN_SPEED * dt;
-        if (IsKeyDown(KEY_RIGHT) || IsKeyDown(KEY_D))
-            angle += SHIP_TURN_SPEED * dt;
-
-        if (IsKeyDown(KEY_UP) || IsKeyDown(KEY_W))
+        swaps = 0;
+        uint32_t bands = std::max(1, (int)(worldHeight / SPAN));
+        bool rebuild = order.size() != asteroids.size() || bandStart.size() != bands + 1;
+        bandHeight = worldHeight / bands;
+        if (rebuild)
         {
-            Vector2 thrust = VecScale(VecFromAngle(angle), SHIP_ACCEL * dt);
-            vel = VecAdd(vel, thrust);
+            order.resize(asteroids.size());
+            for (uint32_t i = 0; i < order.size(); i++)
+                order[i].index = i;
+            bandStart.assign(bands + 1, 0);
         }
+        for (auto &e : order)
+        {
+            const Asteroid &a = asteroids[e.index];
+            e.minX = a.pos.x - a.radius;
+            e.maxX = a.pos.x + a.radius;
+            e.band = std::min(bands - 1, (uint32_t)std::max(0.0f, a.pos.y / bandHeight));
+        }
+        if (rebuild)
+            std::sort(order.begin(), order.end(), Before);
+        else
+        {
+            // The list keeps its size between splits; if it was reshuffled
+            // anyway the indices are still a permutation and this still
+            // sorts.
+            for (size_t i = 1; i < order.size(); i++)
+            {
+                Entry e = order[i];
+                size_t j = i;
+                for (; j > 0 && Before(e, order[j - 1]); j--)
+                    order[j] = order[j - 1];
+                swaps += i - j;
+                order[j] = e;
+            }
+        }
+        uint32_t b = 0;
+        for (uint32_t i = 0; i < order.size(); i++)
+            while (b <= order[i].band)
+                bandStart[b++] = i;
+        while (b <= bands)
+            bandStart[b++] = (uint32_t)order.size();
+    }
 
-        vel = VecScale(vel, powf(SHIP_FRICTION, dt * 60));
-        vel = VecClampLength(vel, SHIP_MAX_SPEED);
-
-        pos = VecAdd(pos, VecScale(vel, dt));
-        pos = WrapPosition(pos);
+    // Calls f(i, j) for every pair of asteroid indices whose x extents
+    // overlap on the torus and whose bands are the same or neighbours, as
+    // of the last Sort. Each pair comes once, except in worlds too small
+    // to hold an asteroid beside its own wrapped image, where a pair
+    // overlapping both ways round may come twice.
+    template <typename F>
+    void ForEachPair(F &&f) const
+    {
+        size_t bands = bandStart.size() - 1;
+        for (size_t b = 0; b < bands; b++)
+        {
+            SweepBand(bandStart[b], bandStart[b + 1], f);
+            // With two bands they neighbour each other on both sides.
+            if (bands > 2 || (bands == 2 && b == 0))
+            {
+                size_t next = (b + 1) % bands;
+                SweepAcross(bandStart[b], bandStart[b + 1], bandStart[next], bandStart[next + 1], f);
+            }
+        }
+    }
 
-        if (cooldown > 0)
-            cooldown -= dt;
-        if (invuln > 0)
-            invuln -= dt;
+    template <typename F>
+    void SweepBand(size_t begin, size_t end, F &f) const
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const Entry &e = order[i];
+            for (size_t j = i + 1; j < end && order[j].minX <= e.maxX; j++)
+                f(e.index, order[j].index);
+            // Across the seam, skipping pairs the forward sweep from j
+            // already found.
+            for (size_t j = begin; j < i && order[j].minX + worldWidth <= e.maxX; j++)
+                if (e.minX > order[j].maxX)
+                    f(e.index, order[j].index);
+        }
     }
 
-    bool CanShoot() const
+    // Pairs between two bands. No extent is wider than SPAN, so the first
+    // candidate in [begin2, end2) only ever moves right as a does.
+    template <typename F>
+    void SweepAcross(size_t begin, size_t end, size_t begin2, size_t end2, F &f) const
     {
-        return cooldown <= 0;
+        size_t first = begin2;
+        for (size_t i = begin; i < end; i++)
+        {
+            const Entry &a = order[i];
+            while (first < end2 && order[first].minX < a.minX - SPAN)
+                first++;
+            for (size_t j = first; j < end2 && order[j].minX <= a.maxX; j++)
+                if (order[j].maxX >= a.minX)
+                    f(a.index, order[j].index);
+            if (a.maxX > worldWidth)
+                for (size_t j = begin2; j < end2 && order[j].minX + worldWidth <= a.maxX; j++)
+                    if (order[j].maxX + worldWidth >= a.minX)
+                        f(a.index, order[j].index);
+            if (a.minX < 0)
+                for (size_t j = end2; j > begin2 && order[j - 1].minX - worldWidth >= a.minX - SPAN; j--)
+                    if (order[j - 1].maxX - worldWidth >= a.minX && order[j - 1].minX - worldWidth <= a.maxX)
+                        f(a.index, order[j - 1].index);
+        }
     }
 
-    Bullet Shoot()
+    void Resolve(SlotMap<Asteroid> &asteroids)
     {
-        cooldown = BULLET_COOLDOWN;
-        Vector2 dir = VecFromAngle(angle);
-        Vector2 p = VecAdd(pos, VecScale(dir, SHIP_RADIUS + 6));
-        Vector2 v = VecAdd(vel, VecScale(dir, BULLET_SPEED));
-        return Bullet(p, v);
+        Sort(asteroids);
+        tested = contacts = 0;
+        ForEachPair([&](uint32_t i, uint32_t j)
+                    { Collide(asteroids[i], asteroids[j]); });
     }
 
-    void Draw() const
+    void Collide(Asteroid &a, Asteroid &b)
     {
-        Vector2 dir = VecFromAngle(angle);
-        Vector2 right = VecFromAngle(angle + 2.5f);
-        Vector2 left = VecFromAngle(angle - 2.5f);
+        tested++;
+        Vector2 d = WrapDelta(a.pos, b.pos);
+        float reach = a.radius + b.radius;
+        float distSq = d.x * d.x + d.y * d.y;
+        if (distSq >= reach * reach)
+            return;
+        contacts++;
 
-        Vector2 p1 = VecAdd(pos, VecScale(dir, SHIP_RADIUS + 8));
-        Vector2 p2 = VecAdd(pos, VecScale(right, SHIP_RADIUS));
-        Vector2 p3 = VecAdd(pos, VecScale(left, SHIP_RADIUS));
+        float dist = sqrtf(distSq);
+        Vector2 n = dist > 0 ? VecScale(d, 1 / dist) : Vector2{1, 0};
+        float invA = 1 / ASTEROID_MASS[a.size], invB = 1 / ASTEROID_MASS[b.size];
+        float invSum = invA + invB;
 
-        Color c = WHITE;
-        if (invuln > 0 && ((int)(invuln * 10) % 2 == 0))
-            c = Fade(WHITE, 0.3f);
+        // Separate along the normal, the lighter one moving further.
+        float overlap = reach - dist;
+        a.pos = WrapPosition(VecAdd(a.pos, VecScale(n, -overlap * invA / invSum)));
+        b.pos = WrapPosition(VecAdd(b.pos, VecScale(n, overlap * invB / invSum)));
 
-        DrawTriangle(p1, p2, p3, c);
-        DrawTriangleLines(p1, p2, p3, SKYBLUE);
+        // Equal and opposite impulse that reverses the closing speed.
+        float closing = (b.vel.x - a.vel.x) * n.x + (b.vel.y - a.vel.y) * n.y;
+        if (closing >= 0)
+            return;
+        float impulse = -2 * closing / invSum;
+        a.vel = VecAdd(a.vel, VecScale(n, -impulse * invA));
+        b.vel = VecAdd(b.vel, VecScale(n, impulse * invB));
     }
 };
 
 // --------------------------------------------------
-// Game
+// Input
 // --------------------------------------------------
 
-struct Game
+// One tick of player intent. Produced by a Controller (keyboard, bot,
+// network...) so the simulation never reads devices directly.
+struct PlayerInput
 {
-    Player player;
-    std::vector<Bullet> bullets;
-    std::vector<Asteroid> asteroids;
-    int score = 0;
-    int lives = LIVES_START;
-    int wave = 1;
-    bool gameOver = false;
+    bool left = false;
+    bool right = false;
+    bool thrust = false;
+    bool fire = false;
+    bool restart = false;
+
+    uint8_t Bits() const
+    {
+        return (uint8_t)(left | right << 1 | thrust << 2 | fire << 3 | restart << 4);
+    }
+
+    static PlayerInput FromBits(uint8_t bits)
+    {
+        PlayerInput in;
+        in.left = bits & 1;
+        in.right = bits & 2;
+        in.thrust = bits & 4;
+        in.fire = bits & 8;
+        in.restart = bits & 16;
+        return in;
+    }
+};
+
+// Fixed-capacity lock-free ring for one producer thread and one consumer
+// thread. Push fails (dropping the item) when the ring is full.
+template <typename T, size_t N>
+struct SpscQueue
+{
+    static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+    T items[N];
+    alignas(64) std::atomic<size_t> head{0}; // next to pop; written by the consumer
+    alignas(64) std::atomic<size_t> tail{0}; // next to push; written by the producer
+
+    bool Push(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N)
+            return false;
+        items[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Oldest item, or null when empty. Stays valid until Pop.
+    const T *Peek() const
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return nullptr;
+        return &items[h & (N - 1)];
+    }
+
+    void Pop()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+// Device input as timestamped transitions of the five PlayerInput actions,
+// so a tick gets what happened up to its own time rather than whatever the
+// keys looked like when the frame was polled, and a tap that comes and goes
+// between two polls still registers.
+enum InputAction : uint8_t
+{
+    ACTION_LEFT,
+    ACTION_RIGHT,
+    ACTION_THRUST,
+    ACTION_FIRE,
+    ACTION_RESTART,
+    ACTION_COUNT
+};
+
+struct InputEvent
+{
+    double time;
+    InputAction action;
+    bool down;
+};
+
+const size_t INPUT_QUEUE_SIZE = 1024;
+using InputQueue = SpscQueue<InputEvent, INPUT_QUEUE_SIZE>;
+
+struct KeyBinding
+{
+    int key;
+    const char *code; // KeyboardEvent.code, for the web build's key callbacks
+    InputAction action;
+};
+
+const KeyBinding KEY_BINDINGS[] = {
+    {KEY_LEFT, "ArrowLeft", ACTION_LEFT},
+    {KEY_A, "KeyA", ACTION_LEFT},
+    {KEY_RIGHT, "ArrowRight", ACTION_RIGHT},
+    {KEY_D, "KeyD", ACTION_RIGHT},
+    {KEY_UP, "ArrowUp", ACTION_THRUST},
+    {KEY_W, "KeyW", ACTION_THRUST},
+    {KEY_SPACE, "Space", ACTION_FIRE},
+    {KEY_ENTER, "Enter", ACTION_RESTART},
+};
+const int KEY_BINDING_COUNT = sizeof(KEY_BINDINGS) / sizeof(KEY_BINDINGS[0]);
+
+// Producer side, on the thread that owns the window. raylib has no event
+// callbacks, so on desktop a transition is stamped with the time of the
+// poll that saw it; the web build also gets key events from the browser
+// as they arrive.
+struct InputCapture
+{
+    InputQueue *queue = nullptr;
+    bool keyDown[KEY_BINDING_COUNT] = {};
+    bool pointer = false; // mouse button held (fires)
+    bool tapping = false; // tap gesture reported by the last Sample
+    bool state[ACTION_COUNT] = {};
+
+    // Every key press sampled since the last ClearPressed, for the UI keys.
+    // raylib's own IsKeyPressed only reports what the latest poll saw, and
+    // the late poll would hide the frame poll's presses from it.
+    int pressed[32];
+    int pressedCount = 0;
+
+    // Counts for the latency report: presses seen, and how many of those
+    // only the late poll caught.
+    int presses = 0;
+    int latePresses = 0;
+
+    void Emit(InputAction a, bool down, double time, bool late)
+    {
+        if (down)
+        {
+            presses++;
+            latePresses += late;
+        }
+        if (queue)
+            queue->Push({time, a, down});
+    }
+
+    // Pushes a transition for every action whose combined state changed.
+    void Update(double time, bool late)
+    {
+        bool now[ACTION_COUNT] = {};
+        for (int i = 0; i < KEY_BINDING_COUNT; i++)
+            now[KEY_BINDINGS[i].action] |= keyDown[i];
+        now[ACTION_FIRE] |= pointer;
+        for (int a = 0; a < ACTION_COUNT; a++)
+        {
+            if (now[a] != state[a])
+            {
+                state[a] = now[a];
+                Emit((InputAction)a, now[a], time, late);
+            }
+        }
+    }
+
+    // Pressed and released between two looks: deliver both.
+    void Tap(InputAction a, double time, bool late)
+    {
+        if (state[a])
+            return;
+        Emit(a, true, time, late);
+        Emit(a, false, time, late);
+    }
+
+    // Reads raylib's device state after a PollInputEvents. `late` marks the
+    // extra poll taken just before simulating.
+    void Sample(double time, bool late)
+    {
+        for (int key = GetKeyPressed(); key != 0; key = GetKeyPressed())
+        {
+            if (pressedCount < 32)
+                pressed[pressedCount++] = key;
+#ifndef __EMSCRIPTEN__
+            for (auto &b : KEY_BINDINGS)
+                if (b.key == key && !IsKeyDown(key))
+                    Tap(b.action, time, late);
+#endif
+        }
+#ifndef __EMSCRIPTEN__
+        for (int i = 0; i < KEY_BINDING_COUNT; i++)
+            keyDown[i] = IsKeyDown(KEY_BINDINGS[i].key);
+#endif
+        pointer = IsMouseButtonDown(MOUSE_LEFT_BUTTON);
+        Update(time, late);
+
+        bool tap = IsGestureDetected(GESTURE_TAP);
+        if (tap && !tapping)
+            Tap(ACTION_FIRE, time, late);
+        tapping = tap;
+    }
+
+    bool Pressed(int key) const
+    {
+        for (int i = 0; i < pressedCount; i++)
+            if (pressed[i] == key)
+                return true;
+        return false;
+    }
+
+    void ClearPressed()
+    {
+        pressedCount = 0;
+    }
+
+    // From the web build's key callbacks.
+    void Key(const char *code, bool down, double time)
+    {
+        for (int i = 0; i < KEY_BINDING_COUNT; i++)
+            if (strcmp(KEY_BINDINGS[i].code, code) == 0)
+                keyDown[i] = down;
+        Update(time, false);
+    }
+};
+
+// Consumer side: replays queued transitions up to a tick's time into held
+// state. A press anywhere in the window fires (or restarts) even if it was
+// released again before the tick.
+struct InputTimeline
+{
+    bool held[ACTION_COUNT] = {};
+    // Earliest press the last Advance delivered, or 0.
+    double pressStamp = 0;
+
+    PlayerInput Advance(InputQueue &queue, double until)
+    {
+        bool pressed[ACTION_COUNT] = {};
+        pressStamp = 0;
+        while (const InputEvent *e = queue.Peek())
+        {
+            if (e->time > until)
+                break;
+            held[e->action] = e->down;
+            if (e->down)
+            {
+                pressed[e->action] = true;
+                if (pressStamp == 0)
+                    pressStamp = e->time;
+            }
+            queue.Pop();
+        }
+
+        PlayerInput in;
+        in.left = held[ACTION_LEFT];
+        in.right = held[ACTION_RIGHT];
+        in.thrust = held[ACTION_THRUST] || pressed[ACTION_THRUST];
+        in.fire = held[ACTION_FIRE] || pressed[ACTION_FIRE];
+        in.restart = pressed[ACTION_RESTART];
+        return in;
+    }
+};
+
+// --------------------------------------------------
+// Player
+// --------------------------------------------------
+
+struct Player
+{
+    Vector2 pos;
+    Vector2 vel;
+    float angle;
+    float cooldown;
+    float invuln;
+    bool alive;
+
+    // VecFromAngle(angle), recomputed only when angle has changed since.
+    mutable Vector2 cachedDir = {1, 0};
+    mutable float cachedAngle = NAN;
+    // powf(SHIP_FRICTION, dt * 60) for the last dt seen; the tick is fixed,
+    // so this is computed once.
+    float frictionDt = -1;
+    float friction = 1;
+
+    Player()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        pos = {worldWidth / 2, worldHeight / 2};
+        vel = {0, 0};
+        angle = -PI / 2;
+        cooldown = 0;
+        invuln = 2.0f;
+        alive = true;
+    }
+
+    void Update(float dt, const PlayerInput &in)
+    {
+        if (in.left)
+            angle -= SHIP_TURN_SPEED * dt;
+        if (in.right)
+            angle += SHIP_TURN_SPEED * dt;
+
+        if (in.thrust)
+        {
+            Vector2 thrust = VecScale(Dir(), SHIP_ACCEL * dt);
+            vel = VecAdd(vel, thrust);
+        }
+
+        if (dt != frictionDt)
+        {
+            frictionDt = dt;
+            friction = powf(SHIP_FRICTION, dt * 60);
+        }
+        vel = VecScale(vel, friction);
+        vel = VecClampLength(vel, SHIP_MAX_SPEED);
+
+        pos = VecAdd(pos, VecScale(vel, dt));
+        pos = WrapPosition(pos);
+
+        if (cooldown > 0)
+            cooldown -= dt;
+        if (invuln > 0)
+            invuln -= dt;
+    }
+
+    Vector2 Dir() const
+    {
+        if (angle != cachedAngle)
+        {
+            cachedDir = VecFromAngle(angle);
+            cachedAngle = angle;
+        }
+        return cachedDir;
+    }
+
+    bool CanShoot() const
+    {
+        return cooldown <= 0;
+    }
+
+    Bullet Shoot()
+    {
+        cooldown = BULLET_COOLDOWN;
+        Vector2 dir = Dir();
+        Vector2 p = VecAdd(pos, VecScale(dir, SHIP_RADIUS + 6));
+        Vector2 v = VecAdd(vel, VecScale(dir, BULLET_SPEED));
+        return Bullet(p, v);
+    }
+
+    // Nose, right and left corners of the hull drawn at `at`.
+    void Corners(Vector2 at, Vector2 &p1, Vector2 &p2, Vector2 &p3) const
+    {
+        // The rear corners sit 2.5 rad either side of the nose.
+        const float COS_WING = -0.80114362f;
+        const float SIN_WING = 0.59847214f;
+        Vector2 dir = Dir();
+        Vector2 right = VecRotate(dir, COS_WING, SIN_WING);
+        Vector2 left = VecRotate(dir, COS_WING, -SIN_WING);
+
+        p1 = VecAdd(at, VecScale(dir, SHIP_RADIUS + 8));
+        p2 = VecAdd(at, VecScale(right, SHIP_RADIUS));
+        p3 = VecAdd(at, VecScale(left, SHIP_RADIUS));
+    }
+
+    // Off phase of the post-respawn blink.
+    bool Blinking() const
+    {
+        return invuln > 0 && ((int)(invuln * 10) % 2 == 0);
+    }
+
+    void Draw(Vector2 at) const
+    {
+        Vector2 p1, p2, p3;
+        Corners(at, p1, p2, p3);
+        Color c = Blinking() ? Fade(WHITE, 0.3f) : WHITE;
+
+        DrawTriangle(p1, p2, p3, c);
+        DrawTriangleLines(p1, p2, p3, SKYBLUE);
+    }
+};
+
+// --------------------------------------------------
+// Snapshot
+// --------------------------------------------------
+
+// Snapshots are flat little-endian records written into a caller-provided
+// buffer. Asteroid outlines are stored as their shape seed, so an asteroid
+// costs 21 bytes and a bullet 20.
+const uint32_t SNAPSHOT_MAGIC = 0x3153445A; // "ZDS1"
+const size_t SNAPSHOT_HEADER_BYTES = 4 + 4 + 4 * 3 + 1 + 4 * 7 + 1 + 4 * 2;
+const size_t SNAPSHOT_BULLET_BYTES = 4 * 5;
+const size_t SNAPSHOT_ASTEROID_BYTES = 4 * 4 + 1 + 4;
+
+struct ByteWriter
+{
+    uint8_t *data;
+    size_t cap;
+    size_t len = 0;
+    bool ok = true;
+
+    ByteWriter(uint8_t *d, size_t c) : data(d), cap(c) {}
+
+    void Put(const void *src, size_t n)
+    {
+        if (!ok || len + n > cap)
+        {
+            ok = false;
+            return;
+        }
+        memcpy(data + len, src, n);
+        len += n;
+    }
+
+    void U8(uint8_t v) { Put(&v, 1); }
+    void U32(uint32_t v) { Put(&v, 4); }
+    void I32(int32_t v) { Put(&v, 4); }
+    void F32(float v) { Put(&v, 4); }
+    void F64(double v) { Put(&v, 8); }
+    void Vec(Vector2 v)
+    {
+        F32(v.x);
+        F32(v.y);
+    }
+};
+
+struct ByteReader
+{
+    const uint8_t *data;
+    size_t len;
+    size_t pos = 0;
+    bool ok = true;
+
+    ByteReader(const uint8_t *d, size_t l) : data(d), len(l) {}
+
+    void Get(void *dst, size_t n)
+    {
+        if (!ok || pos + n > len)
+        {
+            ok = false;
+            memset(dst, 0, n);
+            return;
+        }
+        memcpy(dst, data + pos, n);
+        pos += n;
+    }
+
+    uint8_t U8()
+    {
+        uint8_t v;
+        Get(&v, 1);
+        return v;
+    }
+    uint32_t U32()
+    {
+        uint32_t v;
+        Get(&v, 4);
+        return v;
+    }
+    int32_t I32()
+    {
+        int32_t v;
+        Get(&v, 4);
+        return v;
+    }
+    float F32()
+    {
+        float v;
+        Get(&v, 4);
+        return v;
+    }
+    double F64()
+    {
+        double v;
+        Get(&v, 8);
+        return v;
+    }
+    Vector2 Vec()
+    {
+        float x = F32();
+        float y = F32();
+        return {x, y};
+    }
+};
+
+void PutVarint(ByteWriter &w, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        w.U8((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    w.U8((uint8_t)v);
+}
+
+uint32_t GetVarint(ByteReader &r)
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35 && r.ok; shift += 7)
+    {
+        uint8_t b = r.U8();
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            break;
+    }
+    return v;
+}
+
+// Encodes cur against prev as alternating (unchanged run, literal run) pairs.
+// Bytes past the end of prev always count as changed. Returns the encoded
+// size, or 0 if out is too small.
+size_t EncodeSnapshotDelta(const uint8_t *prev, size_t prevLen,
+                           const uint8_t *cur, size_t curLen,
+                           uint8_t *out, size_t cap)
+{
+    ByteWriter w(out, cap);
+    PutVarint(w, (uint32_t)curLen);
+
+    size_t i = 0;
+    while (i < curLen && w.ok)
+    {
+        size_t same = i;
+        size_t common = std::min(curLen, prevLen);
+        while (same + 8 <= common && memcmp(cur + same, prev + same, 8) == 0)
+            same += 8;
+        while (same < common && cur[same] == prev[same])
+            same++;
+
+        // A literal run ends at the first stretch of 4+ unchanged bytes, so
+        // isolated equal bytes don't cost a pair of varints each.
+        size_t lit = same;
+        while (lit < curLen)
+        {
+            size_t k = lit;
+            while (k < curLen && k < prevLen && cur[k] == prev[k] && k - lit < 4)
+                k++;
+            if (k - lit >= 4 || k == curLen)
+                break;
+            lit = k + 1;
+        }
+
+        PutVarint(w, (uint32_t)(same - i));
+        PutVarint(w, (uint32_t)(lit - same));
+        w.Put(cur + same, lit - same);
+        i = lit;
+    }
+
+    return w.ok ? w.len : 0;
+}
+
+// Rebuilds the snapshot encoded by EncodeSnapshotDelta. Returns its size, or
+// 0 if the delta is malformed or out is too small.
+size_t DecodeSnapshotDelta(const uint8_t *prev, size_t prevLen,
+                           const uint8_t *delta, size_t deltaLen,
+                           uint8_t *out, size_t cap)
+{
+    ByteReader r(delta, deltaLen);
+    size_t curLen = GetVarint(r);
+    if (!r.ok || curLen > cap)
+        return 0;
+
+    size_t i = 0;
+    while (i < curLen && r.ok)
+    {
+        size_t same = GetVarint(r);
+        size_t lit = GetVarint(r);
+        if (i + same > prevLen || i + same + lit > curLen)
+            return 0;
+        memcpy(out + i, prev + i, same);
+        i += same;
+        r.Get(out + i, lit);
+        i += lit;
+    }
+
+    return r.ok && i == curLen ? curLen : 0;
+}
+
+// --------------------------------------------------
+// Particles
+// --------------------------------------------------
+
+const int PARTICLE_CAPACITY = 8192;
+const float PARTICLE_DRAG = 0.96f; // velocity kept per 1/60 s
+const float PARTICLE_SIZE = 2.0f;
+const int PARTICLE_QUADS_PER_BATCH = 4096;
+
+enum EffectKind : uint8_t
+{
+    EFFECT_EXPLODE,
+    EFFECT_THRUST,
+};
+
+// A burst requested by a simulation that doesn't own the pool (the sim
+// thread), replayed with ParticlePool::Play on the thread that does.
+struct EffectEvent
+{
+    EffectKind kind;
+    int size;
+    Vector2 dir; // ship heading, for thrust
+    Vector2 pos;
+    Vector2 vel;
+};
+
+// Fixed-capacity effect particles stored as separate arrays. Emission writes
+// over the oldest slot in ring order and expiry is purely by age, so nothing
+// is ever compacted or freed; dead slots are integrated along with live ones
+// (it keeps the loop branch-free) and skipped when drawing.
+struct ParticlePool
+{
+    int capacity;
+    int used = 0; // slots ever written; integration stops here
+    int next = 0;
+    double clock = 0;
+    double liveUntil = 0; // when the longest-lived particle expires
+    // Own random stream, so effects never perturb (or race with) the game's.
+    uint32_t rng = 0x2545F491u;
+    std::vector<float> x, y, vx, vy, age, life;
+    std::vector<Color> color;
+
+    // Budget knob: emission is scaled by `scale`, which drops while update
+    // plus draw cost exceeds budgetSeconds and recovers when well under it.
+    float scale = 1.0f;
+    double budgetSeconds = 0.0015;
+    double updateTime = 0;
+    double drawTime = 0;
+
+    // Scratch for Gather/Draw.
+    std::vector<float> outX, outY;
+    std::vector<Color> outColor;
+
+    explicit ParticlePool(int cap = PARTICLE_CAPACITY)
+        : capacity(cap), x(cap), y(cap), vx(cap), vy(cap), age(cap, 1), life(cap, 1), color(cap),
+          outX(cap), outY(cap), outColor(cap) {}
+
+    void Emit(Vector2 pos, Vector2 baseVel, int count, float speed, float lifetime, Color c)
+    {
+        int n = (int)(count * scale + 0.5f);
+        for (int k = 0; k < n; k++)
+        {
+            int i = next;
+            next = next + 1 == capacity ? 0 : next + 1;
+            used = std::max(used, i + 1);
+
+            Vector2 v = VecScale(FastVecFromAngle(Random(0, PI * 2)), Random(0.2f, 1.0f) * speed);
+            x[i] = pos.x;
+            y[i] = pos.y;
+            vx[i] = baseVel.x + v.x;
+            vy[i] = baseVel.y + v.y;
+            age[i] = 0;
+            life[i] = lifetime * Random(0.6f, 1.0f);
+            color[i] = c;
+            liveUntil = std::max(liveUntil, clock + life[i]);
+        }
+    }
+
+    float Random(float min, float max)
+    {
+        return min + (float)(NextRandom(rng) >> 8) / 16777216.0f * (max - min);
+    }
+
+    void Explode(Vector2 pos, Vector2 vel, int size)
+    {
+        Emit(pos, VecScale(vel, 0.5f), 10 * size, 60.0f + 40.0f * size, 0.6f + 0.2f * size, LIGHTGRAY);
+        Emit(pos, VecScale(vel, 0.5f), 4 * size, 40.0f, 0.4f, ORANGE);
+    }
+
+    void Thrust(Vector2 pos, Vector2 shipVel, Vector2 dir)
+    {
+        Vector2 back = VecScale(dir, -1);
+        Vector2 at = VecAdd(pos, VecScale(back, SHIP_RADIUS));
+        Emit(at, VecAdd(shipVel, VecScale(back, 120)), 2, 40.0f, 0.35f, ORANGE);
+    }
+
+    void Play(const EffectEvent &e)
+    {
+        if (e.kind == EFFECT_EXPLODE)
+            Explode(e.pos, e.vel, e.size);
+        else
+            Thrust(e.pos, e.vel, e.dir);
+    }
+
+    bool Active() const
+    {
+        return clock < liveUntil;
+    }
+
+    void Update(float dt)
+    {
+        clock += dt;
+        double t0 = NowSeconds();
+        Integrate(0, used, dt, powf(PARTICLE_DRAG, dt * 60));
+        updateTime = NowSeconds() - t0;
+
+        double cost = updateTime + drawTime;
+        if (cost > budgetSeconds)
+            scale = std::max(0.1f, scale * 0.8f);
+        else if (cost < budgetSeconds * 0.6 && scale < 1.0f)
+            scale = std::min(1.0f, scale * 1.05f);
+    }
+
+    void Integrate(int begin, int end, float dt, float drag)
+    {
+        float *__restrict px = x.data();
+        float *__restrict py = y.data();
+        float *__restrict pvx = vx.data();
+        float *__restrict pvy = vy.data();
+        float *__restrict pa = age.data();
+        int i = begin;
+#if defined(__SSE2__)
+        const __m128 vdt = _mm_set1_ps(dt);
+        const __m128 vdrag = _mm_set1_ps(drag);
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128 vx4 = _mm_loadu_ps(pvx + i);
+            __m128 vy4 = _mm_loadu_ps(pvy + i);
+            _mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(vx4, vdt)));
+            _mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(vy4, vdt)));
+            _mm_storeu_ps(pvx + i, _mm_mul_ps(vx4, vdrag));
+            _mm_storeu_ps(pvy + i, _mm_mul_ps(vy4, vdrag));
+            _mm_storeu_ps(pa + i, _mm_add_ps(_mm_loadu_ps(pa + i), vdt));
+        }
+#endif
+        IntegrateScalar(i, end, dt, drag);
+    }
+
+    void IntegrateScalar(int begin, int end, float dt, float drag)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            x[i] += vx[i] * dt;
+            y[i] += vy[i] * dt;
+            vx[i] *= drag;
+            vy[i] *= drag;
+            age[i] += dt;
+        }
+    }
+
+    // Collects live particles visible in `view` into outX/outY/outColor,
+    // shifted to the wrapped copy nearest the view and faded by age.
+    int Gather(const View &view)
+    {
+        int n = 0;
+        for (int i = 0; i < used; i++)
+        {
+            if (age[i] >= life[i])
+                continue;
+            Vector2 p = view.Nearest({x[i], y[i]});
+            if (!view.Visible(p, PARTICLE_SIZE))
+                continue;
+            Color c = color[i];
+            c.a = (unsigned char)(255 * (1 - age[i] / life[i]));
+            outX[n] = p.x;
+            outY[n] = p.y;
+            outColor[n] = c;
+            n++;
+        }
+        return n;
+    }
+
+    // Submits every visible particle as a quad through one rlgl batch
+    // (split only when raylib's batch buffer fills up).
+    void Draw(const View &view)
+    {
+        double t0 = NowSeconds();
+        int n = Gather(view);
+        for (int start = 0; start < n; start += PARTICLE_QUADS_PER_BATCH)
+        {
+            int end = std::min(n, start + PARTICLE_QUADS_PER_BATCH);
+            rlCheckRenderBatchLimit((end - start) * 4);
+            rlSetTexture(0);
+            rlBegin(RL_QUADS);
+            for (int i = start; i < end; i++)
+            {
+                Color c = outColor[i];
+                float px = outX[i], py = outY[i], h = PARTICLE_SIZE / 2;
+                rlColor4ub(c.r, c.g, c.b, c.a);
+                rlVertex2f(px - h, py - h);
+                rlVertex2f(px - h, py + h);
+                rlVertex2f(px + h, py + h);
+                rlVertex2f(px + h, py - h);
+            }
+            rlEnd();
+        }
+        drawTime = NowSeconds() - t0;
+    }
+};
+
+// --------------------------------------------------
+// HUD
+// --------------------------------------------------
+
+// A line of HUD text rasterized into its own render texture. It is redrawn
+// only when its value changes; otherwise a frame costs one textured quad
+// instead of TextFormat + MeasureText + per-glyph DrawText.
+struct HudLabel
+{
+    const char *format; // printf format taking one int, or plain text
+    int fontSize;
+    Color color;
+    int value = INT_MIN;
+    int width = 0;
+    RenderTexture2D target = {};
+
+    HudLabel(const char *f, int size, Color c) : format(f), fontSize(size), color(c) {}
+
+    int Width(int v)
+    {
+        Refresh(v);
+        return width;
+    }
+
+    void Draw(int v, int x, int y)
+    {
+        Refresh(v);
+        // Render textures are stored upside down.
+        Rectangle src = {0, 0, (float)width, -(float)target.texture.height};
+        DrawTextureRec(target.texture, src, {(float)x, (float)y}, WHITE);
+    }
+
+    void Refresh(int v)
+    {
+        if (target.id != 0 && v == value)
+            return;
+
+        const char *text = TextFormat(format, v);
+        int w = MeasureText(text, fontSize);
+        if (target.id == 0 || w > target.texture.width)
+        {
+            if (target.id != 0)
+                UnloadRenderTexture(target);
+            // Slack so growing digit counts don't reallocate every time.
+            target = LoadRenderTexture(w + fontSize * 2, fontSize + 4);
+        }
+
+        BeginTextureMode(target);
+        ClearBackground(BLANK);
+        DrawText(text, 0, 0, fontSize, color);
+        EndTextureMode();
+        value = v;
+        width = w;
+    }
+};
+
+struct Hud
+{
+    // False draws text immediately every frame, for comparison (F4).
+    bool cached = true;
+    double drawTime = 0;
+
+    HudLabel score{"Score: %d", 20, RAYWHITE};
+    HudLabel lives{"Lives: %d", 20, RAYWHITE};
+    HudLabel wave{"Wave: %d", 20, RAYWHITE};
+    HudLabel gameOver{"GAME OVER", 48, RED};
+    HudLabel restart{"Press ENTER to restart", 20, RAYWHITE};
+    HudLabel paused{"PAUSED", 48, RAYWHITE};
+
+    // Rasterizes anything stale now, so a following Draw issues no texture
+    // mode switches (needed while drawing into another render texture).
+    void Prepare(int scoreValue, int livesValue, int waveValue)
+    {
+        if (!cached)
+            return;
+        score.Refresh(scoreValue);
+        lives.Refresh(livesValue);
+        wave.Refresh(waveValue);
+        gameOver.Refresh(0);
+        restart.Refresh(0);
+        paused.Refresh(0);
+    }
+
+    void DrawPaused()
+    {
+        if (cached)
+            paused.Draw(0, SCREEN_WIDTH / 2 - paused.Width(0) / 2, SCREEN_HEIGHT / 2 - 40);
+        else
+            DrawText("PAUSED", SCREEN_WIDTH / 2 - MeasureText("PAUSED", 48) / 2, SCREEN_HEIGHT / 2 - 40, 48, RAYWHITE);
+    }
+
+    void Draw(int scoreValue, int livesValue, int waveValue, bool over)
+    {
+        double t0 = NowSeconds();
+        if (cached)
+        {
+            score.Draw(scoreValue, 20, 20);
+            lives.Draw(livesValue, 20, 45);
+            wave.Draw(waveValue, 20, 70);
+            if (over)
+            {
+                gameOver.Draw(0, SCREEN_WIDTH / 2 - gameOver.Width(0) / 2, SCREEN_HEIGHT / 2 - 40);
+                restart.Draw(0, SCREEN_WIDTH / 2 - restart.Width(0) / 2, SCREEN_HEIGHT / 2 + 20);
+            }
+        }
+        else
+        {
+            DrawText(TextFormat("Score: %d", scoreValue), 20, 20, 20, RAYWHITE);
+            DrawText(TextFormat("Lives: %d", livesValue), 20, 45, 20, RAYWHITE);
+            DrawText(TextFormat("Wave: %d", waveValue), 20, 70, 20, RAYWHITE);
+            if (over)
+            {
+                const char *t = "GAME OVER";
+                const char *s = "Press ENTER to restart";
+                DrawText(t, SCREEN_WIDTH / 2 - MeasureText(t, 48) / 2, SCREEN_HEIGHT / 2 - 40, 48, RED);
+                DrawText(s, SCREEN_WIDTH / 2 - MeasureText(s, 20) / 2, SCREEN_HEIGHT / 2 + 20, 20, RAYWHITE);
+            }
+        }
+        drawTime = NowSeconds() - t0;
+    }
+};
+
+// Only touched from the thread that owns the window.
+Hud hud;
+
+// --------------------------------------------------
+// Event log
+// --------------------------------------------------
+
+// Gameplay events for per-match analytics. The simulation pushes fixed-size
+// records into a lock-free ring and a writer thread appends them to a file,
+// so logging never waits on disk inside a tick.
+enum GameEventKind : uint8_t
+{
+    EVENT_START,      // new match
+    EVENT_SHOT,       // detail: bullets alive after the shot
+    EVENT_HIT,        // detail: size of the asteroid destroyed
+    EVENT_SPLIT,      // detail: size of the two pieces
+    EVENT_DEATH,      // detail: lives left
+    EVENT_WAVE_CLEAR, // wave: the wave just cleared
+    EVENT_GAME_OVER,
+    EVENT_KIND_COUNT
+};
+
+const char *const EVENT_NAMES[] = {"start", "shot", "hit", "split", "death", "wave clear", "game over"};
+
+struct GameEvent
+{
+    double time; // simulation seconds
+    Vector2 pos;
+    int32_t score;
+    uint16_t wave;
+    uint8_t kind;
+    uint8_t detail;
+};
+
+// The file is EVENTLOG_MAGIC and then records, each a varint payload length
+// followed by the payload. A reader skips payload bytes it doesn't know and
+// stops at a truncated final record, so a log cut off by a crash still
+// reads.
+const uint32_t EVENTLOG_MAGIC = 0x3145445A; // "ZDE1"
+const size_t EVENT_PAYLOAD_BYTES = 1 + 1 + 4 + 4 + 4 + 4 * 2;
+const size_t EVENT_QUEUE_SIZE = 4096;
+
+void WriteEvent(ByteWriter &w, const GameEvent &e)
+{
+    PutVarint(w, EVENT_PAYLOAD_BYTES);
+    w.U8(e.kind);
+    w.U8(e.detail);
+    w.U32((uint32_t)(e.time * 1000)); // milliseconds
+    w.I32(e.wave);
+    w.I32(e.score);
+    w.Vec(e.pos);
+}
+
+// Returns false at the end of the log or at a truncated record.
+bool ReadEvent(ByteReader &r, GameEvent &e)
+{
+    uint32_t len = GetVarint(r);
+    if (!r.ok || len < EVENT_PAYLOAD_BYTES || len > r.len - r.pos)
+        return false;
+    size_t end = r.pos + len;
+    e.kind = r.U8();
+    e.detail = r.U8();
+    e.time = r.U32() / 1000.0;
+    e.wave = (uint16_t)r.I32();
+    e.score = r.I32();
+    e.pos = r.Vec();
+    r.pos = end;
+    return true;
+}
+
+struct EventLog
+{
+    SpscQueue<GameEvent, EVENT_QUEUE_SIZE> queue;
+    FILE *file = nullptr;
+    // Events lost to a full ring. Only the producer writes it.
+    uint32_t dropped = 0;
+    uint64_t written = 0;
+#ifdef ZAYDROIDS_THREADS
+    std::thread thread;
+    std::atomic<bool> running{false};
+#endif
+
+    bool Open(const char *path)
+    {
+        file = fopen(path, "ab");
+        if (!file)
+            return false;
+        if (ftell(file) == 0)
+        {
+            uint8_t header[4];
+            ByteWriter w(header, sizeof(header));
+            w.U32(EVENTLOG_MAGIC);
+            fwrite(header, 1, w.len, file);
+        }
+#ifdef ZAYDROIDS_THREADS
+        running = true;
+        thread = std::thread([this]
+                             { Run(); });
+#endif
+        return true;
+    }
+
+    // Producer side: a copy into the ring and one release store.
+    void Emit(const GameEvent &e)
+    {
+        if (!queue.Push(e))
+            dropped++;
+    }
+
+    // Consumer side: writes out everything queued so far. Returns the
+    // number of records written. Without threads the main loop calls this
+    // once a frame.
+    size_t Pump()
+    {
+        uint8_t buf[16384];
+        ByteWriter w(buf, sizeof(buf));
+        size_t count = 0;
+        while (const GameEvent *e = queue.Peek())
+        {
+            if (w.len + 5 + EVENT_PAYLOAD_BYTES > sizeof(buf))
+            {
+                fwrite(buf, 1, w.len, file);
+                w.len = 0;
+            }
+            WriteEvent(w, *e);
+            queue.Pop();
+            count++;
+        }
+        if (count)
+        {
+            fwrite(buf, 1, w.len, file);
+            fflush(file);
+            written += count;
+        }
+        return count;
+    }
+
+#ifdef ZAYDROIDS_THREADS
+    void Run()
+    {
+        while (running.load(std::memory_order_relaxed))
+        {
+            if (!Pump())
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+#endif
+
+    // Call once nothing emits any more.
+    void Close()
+    {
+        if (!file)
+            return;
+#ifdef ZAYDROIDS_THREADS
+        running = false;
+        if (thread.joinable())
+            thread.join();
+#endif
+        Pump();
+        fclose(file);
+        file = nullptr;
+    }
+};
+
+// Aggregates over a whole log.
+struct EventStats
+{
+    uint64_t records = 0;
+    uint64_t byKind[EVENT_KIND_COUNT] = {};
+    uint64_t hitsBySize[4] = {};
+    int matches = 0; // started and finished
+    double matchTime = 0;
+    double startTime = -1;
+    int bestScore = 0;
+    int bestWave = 0;
+
+    void Add(const GameEvent &e)
+    {
+        records++;
+        if (e.kind < EVENT_KIND_COUNT)
+            byKind[e.kind]++;
+        if (e.kind == EVENT_HIT && e.detail < 4)
+            hitsBySize[e.detail]++;
+        if (e.kind == EVENT_START)
+            startTime = e.time;
+        if (e.kind == EVENT_GAME_OVER)
+        {
+            if (startTime >= 0)
+            {
+                matches++;
+                matchTime += e.time - startTime;
+            }
+            startTime = -1;
+            bestScore = std::max(bestScore, (int)e.score);
+            bestWave = std::max(bestWave, (int)e.wave);
+        }
+    }
+
+    // Returns false if the data isn't an event log.
+    bool Read(const uint8_t *data, size_t len)
+    {
+        ByteReader r(data, len);
+        if (r.U32() != EVENTLOG_MAGIC)
+            return false;
+        GameEvent e;
+        while (r.pos < len && ReadEvent(r, e))
+            Add(e);
+        return true;
+    }
+};
+
+#ifdef ZAYDROIDS_MMAP
+// `--events <log>`: maps a log written with --log and prints per-match
+// aggregates.
+int RunEventReport(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        fprintf(stderr, "events: cannot open %s\n", path);
+        return 1;
+    }
+    size_t len = (size_t)st.st_size;
+    void *data = len ? mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    EventStats stats;
+    bool ok = data != MAP_FAILED && stats.Read((const uint8_t *)data, len);
+    if (data != MAP_FAILED)
+        munmap(data, len);
+    if (!ok)
+    {
+        fprintf(stderr, "events: %s is not an event log\n", path);
+        return 1;
+    }
+
+    printf("%s: %llu events, %zu bytes\n", path, (unsigned long long)stats.records, len);
+    for (int k = 0; k < EVENT_KIND_COUNT; k++)
+        printf("  %-11s %llu\n", EVENT_NAMES[k], (unsigned long long)stats.byKind[k]);
+    uint64_t shots = stats.byKind[EVENT_SHOT], hits = stats.byKind[EVENT_HIT];
+    printf("  accuracy    %.1f%% (%llu large, %llu medium, %llu small)\n", shots ? 100.0 * hits / shots : 0,
+           (unsigned long long)stats.hitsBySize[3], (unsigned long long)stats.hitsBySize[2],
+           (unsigned long long)stats.hitsBySize[1]);
+    if (stats.matches)
+        printf("  %d finished matches, %.1f s average, best score %d, furthest wave %d\n", stats.matches,
+               stats.matchTime / stats.matches, stats.bestScore, stats.bestWave);
+    return 0;
+}
+#endif
+
+// --------------------------------------------------
+// Game
+// --------------------------------------------------
+
+struct Game
+{
+    Player player;
+    // Handles to these stay good across ticks until the entity is gone.
+    SlotMap<Bullet> bullets;
+    SlotMap<Asteroid> asteroids;
+    int score = 0;
+    int lives = LIVES_START;
+    int wave = 1;
+    bool gameOver = false;
+
+    // Stress/benchmark settings: a fixed wave size instead of 3 + wave, and
+    // a ship that cannot die.
+    int waveSize = 0;
+    bool invincible = false;
+
+    // Simulation LOD: asteroids far from the ship are advanced every 4th or
+    // 16th tick instead of every tick. Set before play starts.
+    bool simLod = false;
+    // Asteroids bounce off each other (--bounce). Not combined with simLod,
+    // whose lagging asteroids have no current position to collide at.
+    bool bounce = false;
+    AsteroidSweep sweep;
+    double simTime = 0;
+    uint32_t tickCount = 0;
+
+    // LOD schedule: lodBuckets[t % 16] holds the asteroid indices to visit
+    // on tick t. Rebuilt whenever the asteroid list is reshuffled.
+    std::vector<uint32_t> lodBuckets[16];
+    std::vector<uint32_t> lodVisit;
+    bool lodDirty = true;
+
+    // Seconds spent in the last Update, split by phase.
+    double updateTime = 0;
+    double collideTime = 0;
+    // Entities that passed culling in the last Draw.
+    mutable int drawnCount = 0;
+
+    // Cosmetic effects; null in headless sims, which skip them entirely.
+    // A game running off the render thread records them in effectLog
+    // instead.
+    ParticlePool *effects = nullptr;
+    std::vector<EffectEvent> *effectLog = nullptr;
+    // Analytics; null unless --log was given. Only the thread running Update
+    // may emit.
+    EventLog *eventLog = nullptr;
 
     Game()
     {
-        SpawnWave();
+        SpawnWave();
+    }
+
+    void SpawnWave()
+    {
+        asteroids.clear();
+        lodDirty = true;
+        int count = waveSize > 0 ? waveSize : 3 + wave;
+
+        // A large asteroid splits into at most four small ones alive at
+        // once, so the wave never grows the list after this.
+        asteroids.reserve(count * 4);
+        bullets.reserve((size_t)(BULLET_LIFETIME / BULLET_COOLDOWN) + 2);
+
+        std::pmr::vector<Vector2> spots(&frameArena.resource);
+        PlaceStratified(count, player.pos, 200, spots);
+        for (auto &pos : spots)
+            asteroids.emplace_back(pos, 3);
+    }
+
+    void Reset()
+    {
+        score = 0;
+        lives = LIVES_START;
+        wave = 1;
+        gameOver = false;
+        player.Reset();
+        bullets.clear();
+        SpawnWave();
+        Event(EVENT_START, 0, player.pos);
+    }
+
+    void Update(float dt, const PlayerInput &in)
+    {
+        if (gameOver)
+        {
+            if (in.restart)
+                Reset();
+            return;
+        }
+
+        double t0 = NowSeconds();
+
+        player.Update(dt, in);
+        if (in.thrust)
+            Effect({EFFECT_THRUST, 0, player.Dir(), player.pos, player.vel});
+
+        if (in.fire && player.CanShoot())
+        {
+            bullets.push_back(player.Shoot());
+            Event(EVENT_SHOT, (int)bullets.size(), bullets.back().pos);
+        }
+
+        for (auto &b : bullets)
+            b.Update(dt);
+        bullets.RemoveIf([](const Bullet &b)
+                         { return b.life <= 0; });
+
+        UpdateAsteroids(dt);
+        if (bounce)
+            sweep.Resolve(asteroids);
+
+        double t1 = NowSeconds();
+        HandleCollisions();
+        double t2 = NowSeconds();
+        updateTime = t1 - t0;
+        collideTime = t2 - t1;
+
+        if (asteroids.empty())
+        {
+            Event(EVENT_WAVE_CLEAR, 0, player.pos);
+            wave++;
+            player.invuln = 2.0f;
+            SpawnWave();
+        }
+    }
+
+    void UpdateAsteroids(float dt)
+    {
+        simTime += dt;
+        tickCount++;
+
+        if (!simLod || bounce)
+        {
+            for (auto &a : asteroids)
+                a.Update(dt);
+            return;
+        }
+
+        if (lodDirty)
+        {
+            // Visit everything this tick and let the strides spread it out.
+            for (auto &bucket : lodBuckets)
+                bucket.clear();
+            for (uint32_t i = 0; i < asteroids.size(); i++)
+                lodBuckets[tickCount & 15].push_back(i);
+            lodDirty = false;
+        }
+
+        // Skipped asteroids are never touched. Motion is linear, so a visit
+        // catches up all the missed time in one step.
+        std::swap(lodVisit, lodBuckets[tickCount & 15]);
+        for (uint32_t i : lodVisit)
+        {
+            Asteroid &a = asteroids[i];
+            float step = a.updatedAt < 0 ? dt : (float)(simTime - a.updatedAt);
+            a.updatedAt = simTime;
+            a.Update(step);
+            lodBuckets[(tickCount + LodStride(a.pos, dt)) & 15].push_back(i);
+        }
+        lodVisit.clear();
+    }
+
+    // Largest stride (1, 4 or 16 ticks) after which the asteroid at `pos`
+    // still can't have closed in to LOD_ACTIVE_RADIUS of the ship.
+    uint32_t LodStride(Vector2 pos, float dt) const
+    {
+        float margin = VecLen(WrapDelta(player.pos, pos)) - LOD_ACTIVE_RADIUS;
+        float perTick = LOD_MAX_CLOSING_SPEED * dt;
+        if (margin > 16 * perTick)
+            return 16;
+        if (margin > 4 * perTick)
+            return 4;
+        return 1;
+    }
+
+    void HandleCollisions()
+    {
+        // In place of each asteroid hit, its fragments: a surviving asteroid
+        // keeps its handle.
+        asteroids.Rewrite([&](Asteroid &a, SlotMap<Asteroid>::Inserter &out)
+                          {
+                              for (auto &b : bullets)
+                              {
+                                  if (CircleCollision(b.pos, 2, a.pos, a.radius))
+                                  {
+                                      b.life = 0;
+                                      Shatter(a, out);
+                                      return false;
+                                  }
+                              }
+                              return true; });
+        CheckShip();
+    }
+
+    // Scores a shot asteroid and adds its fragments, if any, through `out`.
+    void Shatter(const Asteroid &a, SlotMap<Asteroid>::Inserter &out)
+    {
+        lodDirty = true;
+        score += ASTEROID_SCORE[a.size];
+        Effect({EFFECT_EXPLODE, a.size, {0, 0}, a.pos, a.vel});
+        Event(EVENT_HIT, a.size, a.pos);
+
+        if (a.size > 1)
+        {
+            Event(EVENT_SPLIT, a.size - 1, a.pos);
+            for (int i = 0; i < 2; i++)
+                out.emplace_back(a.pos, a.size - 1);
+        }
+    }
+
+    void CheckShip()
+    {
+        if (player.invuln > 0 || invincible)
+            return;
+        for (auto &a : asteroids)
+        {
+            if (CircleCollision(player.pos, SHIP_RADIUS, a.pos, a.radius))
+            {
+                LoseShip();
+                break;
+            }
+        }
+    }
+
+    void LoseShip()
+    {
+        Effect({EFFECT_EXPLODE, 2, {0, 0}, player.pos, player.vel});
+        lives--;
+        Event(EVENT_DEATH, lives, player.pos);
+        player.Reset();
+        if (lives <= 0)
+        {
+            gameOver = true;
+            Event(EVENT_GAME_OVER, 0, player.pos);
+        }
+    }
+
+    void Effect(const EffectEvent &e)
+    {
+        if (effects)
+            effects->Play(e);
+        if (effectLog)
+            effectLog->push_back(e);
+    }
+
+    void Event(GameEventKind kind, int detail, Vector2 pos)
+    {
+        if (eventLog)
+            eventLog->Emit({simTime, pos, score, (uint16_t)wave, kind, (uint8_t)detail});
+    }
+
+    size_t SnapshotSize() const
+    {
+        return SNAPSHOT_HEADER_BYTES +
+               bullets.size() * SNAPSHOT_BULLET_BYTES +
+               asteroids.size() * SNAPSHOT_ASTEROID_BYTES;
+    }
+
+    // Writes the complete game state into buf without allocating. Returns
+    // the number of bytes written, or 0 if cap is smaller than SnapshotSize().
+    size_t WriteSnapshot(uint8_t *buf, size_t cap) const
+    {
+        ByteWriter w(buf, cap);
+        w.U32(SNAPSHOT_MAGIC);
+        w.U32(rngState);
+        w.I32(score);
+        w.I32(lives);
+        w.I32(wave);
+        w.U8(gameOver);
+
+        w.Vec(player.pos);
+        w.Vec(player.vel);
+        w.F32(player.angle);
+        w.F32(player.cooldown);
+        w.F32(player.invuln);
+        w.U8(player.alive);
+
+        w.U32((uint32_t)bullets.size());
+        w.U32((uint32_t)asteroids.size());
+        for (auto &b : bullets)
+        {
+            w.Vec(b.pos);
+            w.Vec(b.vel);
+            w.F32(b.life);
+        }
+        for (auto &a : asteroids)
+        {
+            w.Vec(a.PositionAt(simTime));
+            w.Vec(a.vel);
+            w.U8((uint8_t)a.size);
+            w.U32(a.shapeSeed);
+        }
+
+        return w.ok ? w.len : 0;
+    }
+
+    // Restores a snapshot written by WriteSnapshot. The entity vectors are
+    // refilled in place, so nothing is allocated once their capacity covers
+    // the snapshot. Returns false (leaving the game untouched) on bad input.
+    bool ReadSnapshot(const uint8_t *buf, size_t len)
+    {
+        ByteReader r(buf, len);
+        if (r.U32() != SNAPSHOT_MAGIC)
+            return false;
+        uint32_t rng = r.U32();
+        int32_t newScore = r.I32();
+        int32_t newLives = r.I32();
+        int32_t newWave = r.I32();
+        bool newGameOver = r.U8() != 0;
+
+        Player p;
+        p.pos = r.Vec();
+        p.vel = r.Vec();
+        p.angle = r.F32();
+        p.cooldown = r.F32();
+        p.invuln = r.F32();
+        p.alive = r.U8() != 0;
+
+        uint32_t bulletCount = r.U32();
+        uint32_t asteroidCount = r.U32();
+        if (!r.ok)
+            return false;
+        size_t left = len - r.pos;
+        if (bulletCount > left / SNAPSHOT_BULLET_BYTES || asteroidCount > left / SNAPSHOT_ASTEROID_BYTES ||
+            left != bulletCount * SNAPSHOT_BULLET_BYTES + asteroidCount * SNAPSHOT_ASTEROID_BYTES)
+            return false;
+
+        // Sizes index the per-size tables, so check them all before
+        // touching anything.
+        const uint8_t *asteroidData = buf + r.pos + bulletCount * SNAPSHOT_BULLET_BYTES;
+        for (uint32_t i = 0; i < asteroidCount; i++)
+        {
+            uint8_t size = asteroidData[i * SNAPSHOT_ASTEROID_BYTES + 4 * 4];
+            if (size < 1 || size > 3)
+                return false;
+        }
+
+        rngState = rng;
+        score = newScore;
+        lives = newLives;
+        wave = newWave;
+        gameOver = newGameOver;
+        player = p;
+
+        bullets.clear();
+        for (uint32_t i = 0; i < bulletCount; i++)
+        {
+            Vector2 pos = r.Vec();
+            Vector2 vel = r.Vec();
+            Bullet b(pos, vel);
+            b.life = r.F32();
+            bullets.push_back(b);
+        }
+
+        asteroids.clear();
+        lodDirty = true;
+        for (uint32_t i = 0; i < asteroidCount; i++)
+        {
+            Vector2 pos = r.Vec();
+            Vector2 vel = r.Vec();
+            int size = r.U8();
+            uint32_t seed = r.U32();
+            asteroids.emplace_back(pos, vel, size, seed);
+        }
+
+        return true;
+    }
+
+    // Draws the world through a camera that follows the ship, submitting
+    // only entities whose nearest wrapped copy overlaps the screen, then the
+    // HUD in screen space.
+    void Draw() const
+    {
+        View view = View::Follow(player.pos);
+        int drawn = 0;
+
+        BeginMode2D(view.Camera());
+        if (effects)
+            effects->Draw(view);
+        for (auto &a : asteroids)
+        {
+            Vector2 at = view.Nearest(a.pos);
+            if (view.Visible(at, a.radius * 1.1f))
+            {
+                a.Draw(at);
+                drawn++;
+            }
+        }
+        for (auto &b : bullets)
+        {
+            Vector2 at = view.Nearest(b.pos);
+            if (view.Visible(at, 2))
+            {
+                b.Draw(at);
+                drawn++;
+            }
+        }
+        if (!gameOver || player.invuln > 0)
+            player.Draw(view.Nearest(player.pos));
+        EndMode2D();
+        drawnCount = drawn;
+
+        hud.Draw(score, lives, wave, gameOver);
+    }
+};
+
+// --------------------------------------------------
+// Controllers
+// --------------------------------------------------
+
+struct Controller
+{
+    virtual ~Controller() {}
+    virtual PlayerInput Poll(const Game &game) = 0;
+};
+
+// Aim-and-shoot heuristic: turn toward where the nearest asteroid will be
+// when a bullet reaches it, fire when that shot connects, and thrust away
+// from anything about to hit the ship. Holds no state beyond the struct, so
+// thousands can run side by side in the headless sim.
+struct BotController : Controller
+{
+    float aimTolerance = 0.08f;
+    float dangerMargin = 70.0f;
+
+    PlayerInput Poll(const Game &game) override
+    {
+        PlayerInput in;
+        if (game.gameOver)
+        {
+            in.restart = true;
+            return in;
+        }
+
+        // Everything relative to the ship, the shortest way round the
+        // torus, so an asteroid just across an edge counts as near.
+        const Player &p = game.player;
+        const Asteroid *target = nullptr;
+        Vector2 toTarget = {0, 0};
+        float best = 0;
+        for (auto &a : game.asteroids)
+        {
+            Vector2 delta = WrapDelta(p.pos, a.pos);
+            float d = delta.x * delta.x + delta.y * delta.y;
+            if (!target || d < best)
+            {
+                target = &a;
+                toTarget = delta;
+                best = d;
+            }
+        }
+        if (!target)
+            return in;
+
+        float dist = sqrtf(best);
+        Vector2 aim = VecAdd(toTarget, VecScale(target->vel, dist / BULLET_SPEED));
+        float want = atan2f(aim.y, aim.x);
+        float diff = remainderf(want - p.angle, PI * 2);
+
+        in.left = diff < -aimTolerance;
+        in.right = diff > aimTolerance;
+
+        Vector2 shotAt = VecScale(p.Dir(), dist);
+        in.fire = CircleCollision(shotAt, 2, aim, target->radius);
+
+        // Facing away from an imminent hit: run.
+        in.thrust = CircleCollision({0, 0}, SHIP_RADIUS + dangerMargin, toTarget, target->radius) &&
+                    fabsf(diff) > PI / 2;
+        return in;
+    }
+};
+
+// --------------------------------------------------
+// Replay
+// --------------------------------------------------
+
+// A recorded run: the settings and RNG seed it started from, then each
+// tick's dt and input bits. The simulation is deterministic given those, so
+// feeding the ticks back through Game::Update reproduces the run (on the
+// same build).
+//
+// Every REPLAY_KEYFRAME_SECONDS of game time the full state is kept as well,
+// so a seek restores the nearest keyframe and simulates only the rest. The
+// file is the header, the ticks, the keyframes, an index of (tick, offset)
+// per keyframe and a footer locating the index:
+//   keyframe  U32 tick, F64 time, F64 simTime, U32 tickCount, U32 size,
+//             snapshot
+//   footer    U32 keyframes, U32 index offset, U32 REPLAY_INDEX_MAGIC
+// Keyframes don't hold the LOD schedule, so with --lod a seek can leave far
+// asteroids a few ticks apart from straight playback.
+const uint32_t REPLAY_MAGIC = 0x3252445A;       // "ZDR2"
+const uint32_t REPLAY_INDEX_MAGIC = 0x5844495A; // "ZIDX"
+const size_t REPLAY_HEADER_BYTES = 4 + 4 + 4 * 2 + 1 + 4 + 1 + 4;
+const size_t REPLAY_TICK_BYTES = 4 + 1;
+const size_t REPLAY_KEYFRAME_HEADER_BYTES = 4 + 8 + 8 + 4 + 4;
+const size_t REPLAY_FOOTER_BYTES = 4 * 3;
+const double REPLAY_KEYFRAME_SECONDS = 10;
+// Largest header values Load accepts. A wave is reserved up front and the
+// world height sizes --bounce's band table, so a corrupt header must not be
+// able to ask for either without limit.
+const int REPLAY_MAX_WAVE_SIZE = 1 << 17;
+const float REPLAY_MAX_WORLD = 1 << 20;
+
+struct ReplayTick
+{
+    float dt;
+    uint8_t input; // PlayerInput::Bits
+};
+
+// The state before ticks[tick] runs.
+struct ReplayKeyframe
+{
+    uint32_t tick;
+    double time; // replay time, the sum of the dts before `tick`
+    double simTime;
+    uint32_t tickCount;
+    std::vector<uint8_t> state; // Game::WriteSnapshot
+};
+
+bool ReadFileBytes(const char *path, std::vector<uint8_t> &out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    out.clear();
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        out.insert(out.end(), buf, buf + n);
+    fclose(f);
+    return true;
+}
+
+struct Replay
+{
+    uint32_t seed = 1;
+    Vector2 world = {(float)SCREEN_WIDTH, (float)SCREEN_HEIGHT};
+    bool simLod = false;
+    bool bounce = false;
+    int waveSize = 0;
+    bool invincible = false;
+    std::vector<ReplayTick> ticks;
+    std::vector<ReplayKeyframe> keyframes; // ascending tick
+    double recordedTime = 0;
+
+    // Puts `game` (and the world size) back to how the recording began.
+    void Start(Game &game) const
+    {
+        worldWidth = world.x;
+        worldHeight = world.y;
+        game.simLod = simLod;
+        game.bounce = bounce;
+        game.waveSize = waveSize;
+        game.invincible = invincible;
+        game.simTime = 0;
+        game.tickCount = 0;
+        SeedRandom(seed);
+        game.Reset();
+    }
+
+    // Starts recording `game` from a fresh match seeded with `newSeed`.
+    void Begin(Game &game, uint32_t newSeed)
+    {
+        seed = newSeed;
+        world = {worldWidth, worldHeight};
+        simLod = game.simLod;
+        bounce = game.bounce;
+        waveSize = game.waveSize;
+        invincible = game.invincible;
+        ticks.clear();
+        keyframes.clear();
+        recordedTime = 0;
+        Start(game);
+    }
+
+    // Records one tick about to run on `game`, keyframing it first when due.
+    void Add(float dt, const PlayerInput &in, const Game &game)
+    {
+        double due = (keyframes.size() + 1) * REPLAY_KEYFRAME_SECONDS;
+        if (recordedTime >= due)
+        {
+            ReplayKeyframe &k = keyframes.emplace_back();
+            k.tick = (uint32_t)ticks.size();
+            k.time = recordedTime;
+            k.simTime = game.simTime;
+            k.tickCount = game.tickCount;
+            k.state.resize(game.SnapshotSize());
+            game.WriteSnapshot(k.state.data(), k.state.size());
+        }
+        ticks.push_back({dt, in.Bits()});
+        recordedTime += dt;
+    }
+
+    // The last keyframe at or before `tick`, or null to start from the top.
+    const ReplayKeyframe *KeyframeBefore(size_t tick) const
+    {
+        auto it = std::upper_bound(keyframes.begin(), keyframes.end(), tick,
+                                   [](size_t t, const ReplayKeyframe &k)
+                                   { return t < k.tick; });
+        return it == keyframes.begin() ? nullptr : &*(it - 1);
+    }
+
+    // First tick that starts at or after `seconds` into the replay.
+    size_t TickAt(double seconds) const
+    {
+        const ReplayKeyframe *k = nullptr;
+        for (auto &frame : keyframes)
+            if (frame.time <= seconds)
+                k = &frame;
+        size_t tick = k ? k->tick : 0;
+        double t = k ? k->time : 0;
+        for (; tick < ticks.size() && t < seconds; tick++)
+            t += ticks[tick].dt;
+        return tick;
+    }
+
+    bool Save(const char *path) const
+    {
+        size_t size = REPLAY_HEADER_BYTES + ticks.size() * REPLAY_TICK_BYTES + REPLAY_FOOTER_BYTES;
+        for (auto &k : keyframes)
+            size += REPLAY_KEYFRAME_HEADER_BYTES + k.state.size() + 4 * 2;
+        std::vector<uint8_t> buf(size);
+        ByteWriter w(buf.data(), buf.size());
+        w.U32(REPLAY_MAGIC);
+        w.U32(seed);
+        w.Vec(world);
+        w.U8(simLod | bounce << 1);
+        w.I32(waveSize);
+        w.U8(invincible);
+        w.U32((uint32_t)ticks.size());
+        for (auto &tick : ticks)
+        {
+            w.F32(tick.dt);
+            w.U8(tick.input);
+        }
+        std::vector<uint32_t> offsets;
+        for (auto &k : keyframes)
+        {
+            offsets.push_back((uint32_t)w.len);
+            w.U32(k.tick);
+            w.F64(k.time);
+            w.F64(k.simTime);
+            w.U32(k.tickCount);
+            w.U32((uint32_t)k.state.size());
+            w.Put(k.state.data(), k.state.size());
+        }
+        uint32_t indexAt = (uint32_t)w.len;
+        for (size_t i = 0; i < keyframes.size(); i++)
+        {
+            w.U32(keyframes[i].tick);
+            w.U32(offsets[i]);
+        }
+        w.U32((uint32_t)keyframes.size());
+        w.U32(indexAt);
+        w.U32(REPLAY_INDEX_MAGIC);
+
+        FILE *f = fopen(path, "wb");
+        if (!f)
+            return false;
+        bool ok = fwrite(buf.data(), 1, w.len, f) == w.len;
+        return fclose(f) == 0 && ok;
+    }
+
+    bool Load(const char *path)
+    {
+        std::vector<uint8_t> buf;
+        if (!ReadFileBytes(path, buf))
+            return false;
+        ByteReader r(buf.data(), buf.size());
+        if (r.U32() != REPLAY_MAGIC)
+            return false;
+        seed = r.U32();
+        world = r.Vec();
+        uint8_t flags = r.U8();
+        simLod = flags & 1;
+        bounce = flags & 2;
+        waveSize = r.I32();
+        invincible = r.U8() != 0;
+        uint32_t count = r.U32();
+        if (!r.ok || !(world.x > 0 && world.x <= REPLAY_MAX_WORLD) || !(world.y > 0 && world.y <= REPLAY_MAX_WORLD) ||
+            waveSize < 0 || waveSize > REPLAY_MAX_WAVE_SIZE || (buf.size() - r.pos) / REPLAY_TICK_BYTES < count)
+            return false;
+        ticks.resize(count);
+        recordedTime = 0;
+        for (auto &tick : ticks)
+        {
+            tick.dt = r.F32();
+            tick.input = r.U8();
+            recordedTime += tick.dt;
+        }
+
+        // Keyframes are found through the footer rather than by scanning.
+        keyframes.clear();
+        if (buf.size() - r.pos < REPLAY_FOOTER_BYTES)
+            return false;
+        ByteReader footer(buf.data() + buf.size() - REPLAY_FOOTER_BYTES, REPLAY_FOOTER_BYTES);
+        uint32_t keyframeCount = footer.U32();
+        uint32_t indexAt = footer.U32();
+        if (footer.U32() != REPLAY_INDEX_MAGIC || indexAt < r.pos || indexAt > buf.size() - REPLAY_FOOTER_BYTES ||
+            (buf.size() - REPLAY_FOOTER_BYTES - indexAt) / 8 < keyframeCount)
+            return false;
+        ByteReader index(buf.data() + indexAt, buf.size() - REPLAY_FOOTER_BYTES - indexAt);
+        for (uint32_t i = 0; i < keyframeCount; i++)
+        {
+            uint32_t tick = index.U32();
+            uint32_t offset = index.U32();
+            if (offset >= indexAt)
+                return false;
+            ByteReader k(buf.data() + offset, indexAt - offset);
+            ReplayKeyframe &frame = keyframes.emplace_back();
+            frame.tick = k.U32();
+            frame.time = k.F64();
+            frame.simTime = k.F64();
+            frame.tickCount = k.U32();
+            uint32_t size = k.U32();
+            if (!k.ok || frame.tick != tick || tick > count || size > k.len - k.pos ||
+                (i > 0 && tick < keyframes[i - 1].tick))
+                return false;
+            frame.state.assign(buf.data() + offset + k.pos, buf.data() + offset + k.pos + size);
+        }
+        return r.ok;
+    }
+};
+
+// Plays a Replay into its own Game, with random access.
+struct ReplayPlayer
+{
+    const Replay &replay;
+    Game game;
+    size_t tick = 0; // next tick to run
+    double time = 0;
+
+    explicit ReplayPlayer(const Replay &r) : replay(r)
+    {
+        replay.Start(game);
+    }
+
+    bool Done() const { return tick >= replay.ticks.size(); }
+
+    void Step()
+    {
+        const ReplayTick &t = replay.ticks[tick++];
+        frameArena.Reset();
+        game.Update(t.dt, PlayerInput::FromBits(t.input));
+        time += t.dt;
+    }
+
+    // Moves to just before ticks[target] runs: from here if no keyframe lies
+    // in between, otherwise from the nearest keyframe.
+    void Seek(size_t target)
+    {
+        target = std::min(target, replay.ticks.size());
+        const ReplayKeyframe *k = replay.KeyframeBefore(target);
+        if (target < tick || (k && k->tick > tick))
+        {
+            if (k && game.ReadSnapshot(k->state.data(), k->state.size()))
+            {
+                game.simTime = k->simTime;
+                game.tickCount = k->tickCount;
+                tick = k->tick;
+                time = k->time;
+            }
+            else
+            {
+                replay.Start(game);
+                tick = 0;
+                time = 0;
+            }
+        }
+        while (tick < target)
+            Step();
+    }
+};
+
+// --------------------------------------------------
+// Sim thread
+// --------------------------------------------------
+
+// Wait-free single-producer/single-consumer handoff. The writer fills Back()
+// and publishes it; Acquire() swaps the newest published slot to the front,
+// where it stays untouched until the next Acquire. Neither side ever waits:
+// a slow reader just skips frames.
+template <typename T>
+struct TripleBuffer
+{
+    static const uint8_t FRESH = 4; // published slot not yet acquired
+
+    T slots[3];
+    std::atomic<uint8_t> middle{1};
+    uint8_t back = 0;
+    uint8_t front = 2;
+
+    T &Back() { return slots[back]; }
+    T &Front() { return slots[front]; }
+
+    // True while the last publish hasn't been acquired yet.
+    bool Pending() const
+    {
+        return (middle.load(std::memory_order_acquire) & FRESH) != 0;
+    }
+
+    // Returns true if the slot handed back to the writer was never read,
+    // i.e. the previous publish was dropped; its contents are still intact.
+    bool Publish()
+    {
+        uint8_t old = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = old & 3;
+        return (old & FRESH) != 0;
+    }
+
+    // Returns false (keeping the current front) if nothing new was published.
+    bool Acquire()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        uint8_t old = middle.exchange(front, std::memory_order_acq_rel);
+        front = old & 3;
+        return true;
+    }
+};
+
+// Everything the render side needs from one finished tick. Copied out of the
+// sim's Game, so nothing in it is touched by the sim once published.
+struct RenderFrame
+{
+    Player player;
+    SlotMap<Bullet> bullets;
+    SlotMap<Asteroid> asteroids;
+    int score = 0;
+    int lives = LIVES_START;
+    int wave = 1;
+    bool gameOver = false;
+    double updateTime = 0;
+    double collideTime = 0;
+    // Effects raised since the last frame the render side acquired.
+    std::vector<EffectEvent> effects;
+    // Time of the earliest press this frame is the first to show, or 0.
+    double pressStamp = 0;
+
+    void Capture(const Game &g)
+    {
+        player = g.player;
+        // Copy-assigned so the render side can resolve the sim's handles.
+        bullets = g.bullets;
+        asteroids = g.asteroids;
+        score = g.score;
+        lives = g.lives;
+        wave = g.wave;
+        gameOver = g.gameOver;
+        updateTime = g.updateTime;
+        collideTime = g.collideTime;
+    }
+
+    // Hands the frame to a render-side Game so Draw, the HUD and the stats
+    // overlay work unchanged. The entity lists are swapped rather than
+    // copied; the frame is left holding stale data, which is fine because
+    // Capture overwrites it before the slot is published again.
+    void MoveInto(Game &g)
+    {
+        g.player = player;
+        g.bullets.swap(bullets);
+        g.asteroids.swap(asteroids);
+        g.score = score;
+        g.lives = lives;
+        g.wave = wave;
+        g.gameOver = gameOver;
+        g.updateTime = updateTime;
+        g.collideTime = collideTime;
+    }
+};
+
+#ifdef ZAYDROIDS_THREADS
+const int SIM_TICK_HZ = 60;
+
+// Runs a Game at a fixed tick on its own thread. Input goes in through an
+// InputQueue, finished ticks come out through a TripleBuffer, and the
+// render thread never blocks on the simulation (or the other way round).
+struct SimThread
+{
+    Game game;
+    TripleBuffer<RenderFrame> frames;
+    std::vector<EffectEvent> pendingEffects;
+
+    // Filled by the render thread's InputCapture; each tick takes the
+    // events stamped up to its own start time.
+    InputQueue input;
+    InputTimeline timeline;
+    double pendingPress = 0;
+
+    std::atomic<bool> paused{false};
+    std::atomic<bool> running{false};
+    std::atomic<uint32_t> ticks{0};
+    std::thread thread;
+
+    // Ticks per second; 0 ticks as soon as the last frame has been taken,
+    // keeping exactly one frame in flight (benchmarks).
+    int tickHz = SIM_TICK_HZ;
+    // When set, polled on the sim thread instead of reading `input`.
+    Controller *controller = nullptr;
+    // When set, every tick is appended to it. Read it only after Stop().
+    Replay *recording = nullptr;
+
+    // Continues from a copy of `from`; until Stop() the caller's game should
+    // only be updated through MoveInto.
+    void Start(const Game &from)
+    {
+        game = from;
+        game.effects = nullptr;
+        game.effectLog = &pendingEffects;
+        pendingEffects.reserve(256);
+        for (auto &slot : frames.slots)
+        {
+            slot.Capture(game);
+            slot.effects.reserve(256);
+        }
+        running = true;
+        thread = std::thread([this]
+                             { Run(); });
+    }
+
+    void Stop()
+    {
+        running = false;
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void Tick(float dt, double until)
+    {
+        frameArena.Reset();
+        PlayerInput in = timeline.Advance(input, until);
+        if (controller)
+            in = controller->Poll(game);
+        else if (timeline.pressStamp != 0 && pendingPress == 0)
+            pendingPress = timeline.pressStamp;
+        if (recording)
+            recording->Add(dt, in, game);
+        game.Update(dt, in);
+        ticks.fetch_add(1, std::memory_order_relaxed);
+
+        RenderFrame &out = frames.Back();
+        out.Capture(game);
+        out.effects.swap(pendingEffects);
+        pendingEffects.clear();
+        out.pressStamp = pendingPress;
+        pendingPress = 0;
+        if (frames.Publish())
+        {
+            // The render side skipped the last frame; carry its effects over.
+            RenderFrame &dropped = frames.Back();
+            pendingEffects.insert(pendingEffects.end(), dropped.effects.begin(), dropped.effects.end());
+            pendingPress = dropped.pressStamp;
+        }
+    }
+
+    void Run()
+    {
+        const double step = 1.0 / (tickHz > 0 ? tickHz : SIM_TICK_HZ);
+        double next = NowSeconds();
+        while (running.load(std::memory_order_relaxed))
+        {
+            if (tickHz <= 0 && frames.Pending())
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            if (!paused.load(std::memory_order_relaxed))
+                Tick((float)step, tickHz > 0 ? next : NowSeconds());
+            else
+                timeline.Advance(input, NowSeconds()); // keep held keys current
+            if (tickHz <= 0)
+                continue;
+
+            next += step;
+            double wait = next - NowSeconds();
+            if (wait > 0)
+                std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+            else if (wait < -MAX_FRAME_DT)
+                next = NowSeconds(); // fell far behind; don't try to catch up
+        }
+    }
+};
+#endif
+
+// --------------------------------------------------
+// Frame pacing
+// --------------------------------------------------
+
+// Replaces raylib's SetTargetFPS, whose wait is one coarse sleep.
+//   uncapped  no waiting at all
+//   vsync     the swap blocks until the display's vblank
+//   target    a fixed rate without vsync: the swap waits for its deadline,
+//             sleeping until shortly before it and spinning the rest
+//   latency   vsync, but the frame starts as late as it can before the
+//             predicted vblank, so input is sampled just in time
+enum PaceMode
+{
+    PACE_UNCAPPED,
+    PACE_VSYNC,
+    PACE_TARGET,
+    PACE_LATENCY,
+};
+
+const char *const PACE_NAMES[] = {"uncapped", "vsync", "target", "latency"};
+
+// Frame-interval statistics over the last WINDOW frames.
+struct FrameStats
+{
+    static constexpr int WINDOW = 240;
+    double interval[WINDOW] = {};
+    bool missed[WINDOW] = {};
+    int count = 0;
+    int next = 0;
+
+    void Add(double seconds, bool miss)
+    {
+        interval[next] = seconds;
+        missed[next] = miss;
+        next = (next + 1) % WINDOW;
+        count = std::min(count + 1, WINDOW);
+    }
+
+    double Mean() const
+    {
+        double sum = 0;
+        for (int i = 0; i < count; i++)
+            sum += interval[i];
+        return count ? sum / count : 0;
+    }
+
+    double StdDev() const
+    {
+        double mean = Mean(), sum = 0;
+        for (int i = 0; i < count; i++)
+            sum += (interval[i] - mean) * (interval[i] - mean);
+        return count ? sqrt(sum / count) : 0;
+    }
+
+    int Missed() const
+    {
+        int n = 0;
+        for (int i = 0; i < count; i++)
+            n += missed[i];
+        return n;
+    }
+};
+
+struct FramePacer
+{
+    PaceMode mode = PACE_TARGET;
+    double period = 1.0 / 60;
+    // Extra floor on the frame interval, for the idle rate.
+    double minInterval = 0;
+
+    double deadline = 0;     // when the frame in progress should be shown
+    double frameStart = 0;   // end of the last wait
+    double lastPresent = 0;  // return of the last swap
+    double workPeak = 0;     // recent worst frame start to swap, slowly decaying
+    // How far a sleep has been seen to overshoot; the spin covers it.
+    double sleepSlack = 0.001;
+    FrameStats stats;
+
+    bool UsesVsync() const { return mode == PACE_VSYNC || mode == PACE_LATENCY; }
+
+    void WaitUntil(double t)
+    {
+        double before = NowSeconds();
+        double sleep = t - before - sleepSlack;
+        if (sleep > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::duration<double>(sleep));
+            double over = NowSeconds() - (before + sleep);
+            sleepSlack = std::clamp(std::max(over * 1.25, sleepSlack * 0.99), 0.0002, 0.004);
+        }
+        while (NowSeconds() < t)
+        {
+        }
+    }
+
+    // Before sampling input. Only latency mode waits here, until the
+    // predicted vblank minus the expected frame cost.
+    void BeginFrame()
+    {
+        if (mode == PACE_LATENCY && lastPresent > 0)
+        {
+            double start = lastPresent + period - workPeak - 0.001;
+            WaitUntil(start);
+        }
+        frameStart = NowSeconds();
+    }
+
+    // Right before the swap. Everything up to here is work latency mode
+    // has to budget for; in target mode (or while idling) the swap is then
+    // held until its deadline, so frames reach the screen evenly spaced
+    // however long each one took to build.
+    void Submit()
+    {
+        double now = NowSeconds();
+        workPeak = std::max(now - frameStart, workPeak * 0.995);
+
+        if (mode == PACE_TARGET)
+        {
+            deadline += period;
+            if (deadline < now)
+                deadline = now; // late: start over from here rather than rush to catch up
+            WaitUntil(deadline);
+        }
+        if (minInterval > 0)
+            WaitUntil(lastPresent + minInterval);
+    }
+
+    // After the swap returns.
+    void Presented()
+    {
+        double now = NowSeconds();
+        if (lastPresent > 0)
+        {
+            double interval = now - lastPresent;
+            bool miss = mode != PACE_UNCAPPED && interval > std::max(period, minInterval) * 1.5;
+            stats.Add(interval, miss);
+        }
+        lastPresent = now;
+    }
+};
+
+// --------------------------------------------------
+// Software renderer
+// --------------------------------------------------
+
+// Draws what Game::Draw shows (asteroid outlines, bullets, the ship and the
+// HUD; particles are left out) on the CPU, for turning replays into video on
+// machines without a GPU. Primitives are binned into 64x64 tiles as they are
+// added, then worker threads each take whole tiles, rasterize them into
+// palette indices and convert straight to 4:2:0 YUV for a y4m stream.
+#ifdef ZAYDROIDS_THREADS
+enum SoftColor : uint8_t
+{
+    SOFT_BACKGROUND,
+    SOFT_ASTEROID,
+    SOFT_BULLET,
+    SOFT_SHIP,
+    SOFT_SHIP_BLINK, // Fade(WHITE, 0.3f) over the background
+    SOFT_OUTLINE,
+    SOFT_TEXT,
+    SOFT_ALERT,
+    SOFT_COLOR_COUNT
+};
+
+const Color SOFT_PALETTE[SOFT_COLOR_COUNT] = {
+    {10, 12, 20, 255}, LIGHTGRAY, YELLOW, WHITE, {84, 85, 91, 255}, SKYBLUE, RAYWHITE, RED};
+
+enum SoftPrimKind : uint8_t
+{
+    SOFT_LINE,     // a -> b
+    SOFT_TRIANGLE, // a, b, c
+    SOFT_DISC,     // center a, radius b.x
+    SOFT_GLYPH,    // top-left a, scale b.x
+};
+
+struct SoftPrim
+{
+    uint8_t kind;
+    uint8_t color;
+    uint8_t glyph;
+    Vector2 a, b, c;
+};
+
+// 5x7 glyphs for the HUD, one byte per row with the leftmost pixel in bit 4.
+const char SOFT_FONT_CHARS[] = "0123456789ACEGILMNOPRSTVW:";
+const uint8_t SOFT_FONT[][7] = {
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E},
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E},
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E},
+    {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08},
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C},
+    {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E},
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}, {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F},
+    {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F},
+    {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}, {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11},
+    {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10},
+    {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}, {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E},
+    {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04},
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}, {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00},
+};
+
+// The part of the frame one tile covers, with its own scratch pixels.
+struct SoftTile
+{
+    static const int SIZE = 64;
+    int x0, y0, x1, y1;
+    uint8_t pixels[SIZE * SIZE];
+
+    void Set(int x, int y, uint8_t color) { pixels[(y - y0) * SIZE + (x - x0)] = color; }
+};
+
+struct SoftRenderer
+{
+    static const int WIDTH = SCREEN_WIDTH;
+    static const int HEIGHT = SCREEN_HEIGHT;
+    static const int TILES_X = (WIDTH + SoftTile::SIZE - 1) / SoftTile::SIZE;
+    static const int TILES_Y = (HEIGHT + SoftTile::SIZE - 1) / SoftTile::SIZE;
+    static const size_t FRAME_BYTES = WIDTH * HEIGHT * 3 / 2;
+    static_assert(WIDTH % 2 == 0 && HEIGHT % 2 == 0 && SoftTile::SIZE % 2 == 0, "tiles must cover whole chroma samples");
+
+    std::vector<SoftPrim> prims;
+    std::vector<uint32_t> bins[TILES_X * TILES_Y];
+    uint8_t lumaOf[SOFT_COLOR_COUNT], cbOf[SOFT_COLOR_COUNT], crOf[SOFT_COLOR_COUNT];
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    uint64_t generation = 0;
+    int busy = 0;
+    bool quit = false;
+    std::atomic<int> nextTile{0};
+    uint8_t *target = nullptr;
+
+    explicit SoftRenderer(int threads)
+    {
+        // BT.601, limited range, as y4m players assume.
+        for (int i = 0; i < SOFT_COLOR_COUNT; i++)
+        {
+            float r = SOFT_PALETTE[i].r, g = SOFT_PALETTE[i].g, b = SOFT_PALETTE[i].b;
+            lumaOf[i] = (uint8_t)lroundf(16 + (65.481f * r + 128.553f * g + 24.966f * b) / 255);
+            cbOf[i] = (uint8_t)lroundf(128 + (-37.797f * r - 74.203f * g + 112.0f * b) / 255);
+            crOf[i] = (uint8_t)lroundf(128 + (112.0f * r - 93.786f * g - 18.214f * b) / 255);
+        }
+        for (int i = 0; i < std::max(1, threads); i++)
+            workers.emplace_back([this]
+                                 { Work(); });
+    }
+
+    ~SoftRenderer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (auto &w : workers)
+            w.join();
+    }
+
+    void Clear()
+    {
+        prims.clear();
+        for (auto &bin : bins)
+            bin.clear();
+    }
+
+    void Add(const SoftPrim &p, float minX, float minY, float maxX, float maxY)
+    {
+        if (maxX < 0 || maxY < 0 || minX >= WIDTH || minY >= HEIGHT)
+            return;
+        int tx0 = std::max(0, (int)minX / SoftTile::SIZE), tx1 = std::min(TILES_X - 1, (int)maxX / SoftTile::SIZE);
+        int ty0 = std::max(0, (int)minY / SoftTile::SIZE), ty1 = std::min(TILES_Y - 1, (int)maxY / SoftTile::SIZE);
+        uint32_t index = (uint32_t)prims.size();
+        prims.push_back(p);
+        for (int ty = ty0; ty <= ty1; ty++)
+            for (int tx = tx0; tx <= tx1; tx++)
+                bins[ty * TILES_X + tx].push_back(index);
+    }
+
+    void Line(Vector2 a, Vector2 b, uint8_t color)
+    {
+        Add({SOFT_LINE, color, 0, a, b, {}}, std::min(a.x, b.x) - 1, std::min(a.y, b.y) - 1,
+            std::max(a.x, b.x) + 1, std::max(a.y, b.y) + 1);
+    }
+
+    void Triangle(Vector2 a, Vector2 b, Vector2 c, uint8_t color)
+    {
+        Add({SOFT_TRIANGLE, color, 0, a, b, c}, std::min({a.x, b.x, c.x}), std::min({a.y, b.y, c.y}),
+            std::max({a.x, b.x, c.x}), std::max({a.y, b.y, c.y}));
+    }
+
+    void Disc(Vector2 center, float radius, uint8_t color)
+    {
+        Add({SOFT_DISC, color, 0, center, {radius, 0}, {}}, center.x - radius, center.y - radius,
+            center.x + radius, center.y + radius);
+    }
+
+    static int TextWidth(const char *text, int scale)
+    {
+        int n = (int)strlen(text);
+        return n ? (n * 6 - 1) * scale : 0;
+    }
+
+    void Text(const char *text, int x, int y, int scale, uint8_t color)
+    {
+        for (; *text; text++, x += 6 * scale)
+        {
+            const char *found = strchr(SOFT_FONT_CHARS, toupper((unsigned char)*text));
+            if (*text == ' ' || !found)
+                continue;
+            Vector2 at = {(float)x, (float)y};
+            Add({SOFT_GLYPH, color, (uint8_t)(found - SOFT_FONT_CHARS), at, {(float)scale, 0}, {}},
+                at.x, at.y, at.x + 5 * scale, at.y + 7 * scale);
+        }
+    }
+
+    // The same picture as Game::Draw, minus particles.
+    void Draw(const Game &game)
+    {
+        Clear();
+        View view = View::Follow(game.player.pos);
+        Vector2 shift = {view.halfW - view.center.x, view.halfH - view.center.y};
+
+        for (auto &a : game.asteroids)
+        {
+            Vector2 at = view.Nearest(a.pos);
+            if (!view.Visible(at, a.radius * 1.1f))
+                continue;
+            at = VecAdd(at, shift);
+            for (int i = 0; i < a.pointCount; i++)
+                Line(VecAdd(at, a.points[i]), VecAdd(at, a.points[(i + 1) % a.pointCount]), SOFT_ASTEROID);
+        }
+        for (auto &b : game.bullets)
+        {
+            Vector2 at = view.Nearest(b.pos);
+            if (view.Visible(at, 2))
+                Disc(VecAdd(at, shift), 2, SOFT_BULLET);
+        }
+        if (!game.gameOver || game.player.invuln > 0)
+        {
+            Vector2 p1, p2, p3;
+            game.player.Corners(VecAdd(view.Nearest(game.player.pos), shift), p1, p2, p3);
+            Triangle(p1, p2, p3, game.player.Blinking() ? SOFT_SHIP_BLINK : SOFT_SHIP);
+            Line(p1, p2, SOFT_OUTLINE);
+            Line(p2, p3, SOFT_OUTLINE);
+            Line(p3, p1, SOFT_OUTLINE);
+        }
+
+        char line[32];
+        snprintf(line, sizeof(line), "Score: %d", game.score);
+        Text(line, 20, 20, 2, SOFT_TEXT);
+        snprintf(line, sizeof(line), "Lives: %d", game.lives);
+        Text(line, 20, 45, 2, SOFT_TEXT);
+        snprintf(line, sizeof(line), "Wave: %d", game.wave);
+        Text(line, 20, 70, 2, SOFT_TEXT);
+        if (game.gameOver)
+        {
+            const char *t = "GAME OVER";
+            const char *s = "Press ENTER to restart";
+            Text(t, WIDTH / 2 - TextWidth(t, 6) / 2, HEIGHT / 2 - 40, 6, SOFT_ALERT);
+            Text(s, WIDTH / 2 - TextWidth(s, 2) / 2, HEIGHT / 2 + 20, 2, SOFT_TEXT);
+        }
+    }
+
+    // Pixels are hit where the line crosses their center row (or column,
+    // for steep lines), like GL line rasterization.
+    static void RasterLine(SoftTile &t, const SoftPrim &p)
+    {
+        Vector2 a = p.a, b = p.b;
+        bool steep = fabsf(b.y - a.y) > fabsf(b.x - a.x);
+        if (steep)
+        {
+            std::swap(a.x, a.y);
+            std::swap(b.x, b.y);
+        }
+        if (a.x > b.x)
+            std::swap(a, b);
+        float slope = b.x > a.x ? (b.y - a.y) / (b.x - a.x) : 0;
+        int major0 = steep ? t.y0 : t.x0, major1 = steep ? t.y1 : t.x1;
+        int minor0 = steep ? t.x0 : t.y0, minor1 = steep ? t.x1 : t.y1;
+        int i0 = std::max((int)ceilf(a.x - 0.5f), major0);
+        int i1 = std::min((int)floorf(b.x - 0.5f), major1 - 1);
+        for (int i = i0; i <= i1; i++)
+        {
+            int j = (int)floorf(a.y + (i + 0.5f - a.x) * slope);
+            if (j < minor0 || j >= minor1)
+                continue;
+            if (steep)
+                t.Set(j, i, p.color);
+            else
+                t.Set(i, j, p.color);
+        }
+    }
+
+    static void RasterTriangle(SoftTile &t, const SoftPrim &p)
+    {
+        Vector2 a = p.a, b = p.b, c = p.c;
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (area == 0)
+            return;
+        if (area < 0)
+            std::swap(b, c);
+        int x0 = std::max(t.x0, (int)floorf(std::min({a.x, b.x, c.x})));
+        int x1 = std::min(t.x1 - 1, (int)ceilf(std::max({a.x, b.x, c.x})));
+        int y0 = std::max(t.y0, (int)floorf(std::min({a.y, b.y, c.y})));
+        int y1 = std::min(t.y1 - 1, (int)ceilf(std::max({a.y, b.y, c.y})));
+        auto edge = [](Vector2 u, Vector2 v, float x, float y)
+        { return (v.x - u.x) * (y - u.y) - (v.y - u.y) * (x - u.x); };
+        for (int y = y0; y <= y1; y++)
+        {
+            float cy = y + 0.5f;
+            for (int x = x0; x <= x1; x++)
+            {
+                float cx = x + 0.5f;
+                if (edge(a, b, cx, cy) >= 0 && edge(b, c, cx, cy) >= 0 && edge(c, a, cx, cy) >= 0)
+                    t.Set(x, y, p.color);
+            }
+        }
+    }
+
+    static void RasterDisc(SoftTile &t, const SoftPrim &p)
+    {
+        float r = p.b.x;
+        int x0 = std::max(t.x0, (int)floorf(p.a.x - r)), x1 = std::min(t.x1 - 1, (int)ceilf(p.a.x + r));
+        int y0 = std::max(t.y0, (int)floorf(p.a.y - r)), y1 = std::min(t.y1 - 1, (int)ceilf(p.a.y + r));
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+            {
+                float dx = x + 0.5f - p.a.x, dy = y + 0.5f - p.a.y;
+                if (dx * dx + dy * dy <= r * r)
+                    t.Set(x, y, p.color);
+            }
+    }
+
+    static void RasterGlyph(SoftTile &t, const SoftPrim &p)
+    {
+        int scale = (int)p.b.x, gx = (int)p.a.x, gy = (int)p.a.y;
+        const uint8_t *rows = SOFT_FONT[p.glyph];
+        int x0 = std::max(t.x0, gx), x1 = std::min(t.x1, gx + 5 * scale);
+        int y0 = std::max(t.y0, gy), y1 = std::min(t.y1, gy + 7 * scale);
+        for (int y = y0; y < y1; y++)
+        {
+            uint8_t bits = rows[(y - gy) / scale];
+            for (int x = x0; x < x1; x++)
+                if (bits & (0x10 >> ((x - gx) / scale)))
+                    t.Set(x, y, p.color);
+        }
+    }
+
+    void RenderTile(int index, SoftTile &t)
+    {
+        t.x0 = index % TILES_X * SoftTile::SIZE;
+        t.y0 = index / TILES_X * SoftTile::SIZE;
+        t.x1 = std::min(t.x0 + SoftTile::SIZE, (int)WIDTH);
+        t.y1 = std::min(t.y0 + SoftTile::SIZE, (int)HEIGHT);
+        memset(t.pixels, SOFT_BACKGROUND, sizeof(t.pixels));
+        for (uint32_t i : bins[index])
+        {
+            const SoftPrim &p = prims[i];
+            switch (p.kind)
+            {
+            case SOFT_LINE:
+                RasterLine(t, p);
+                break;
+            case SOFT_TRIANGLE:
+                RasterTriangle(t, p);
+                break;
+            case SOFT_DISC:
+                RasterDisc(t, p);
+                break;
+            case SOFT_GLYPH:
+                RasterGlyph(t, p);
+                break;
+            }
+        }
+
+        uint8_t *lumaPlane = target;
+        uint8_t *cbPlane = target + WIDTH * HEIGHT;
+        uint8_t *crPlane = cbPlane + WIDTH * HEIGHT / 4;
+        for (int y = t.y0; y < t.y1; y++)
+        {
+            const uint8_t *row = &t.pixels[(y - t.y0) * SoftTile::SIZE];
+            uint8_t *out = lumaPlane + y * WIDTH + t.x0;
+            for (int x = 0; x < t.x1 - t.x0; x++)
+                out[x] = lumaOf[row[x]];
+        }
+        for (int y = t.y0; y < t.y1; y += 2)
+        {
+            const uint8_t *top = &t.pixels[(y - t.y0) * SoftTile::SIZE];
+            const uint8_t *bottom = top + SoftTile::SIZE;
+            int offset = y / 2 * (WIDTH / 2) + t.x0 / 2;
+            for (int x = 0; x < t.x1 - t.x0; x += 2)
+            {
+                int cb = cbOf[top[x]] + cbOf[top[x + 1]] + cbOf[bottom[x]] + cbOf[bottom[x + 1]];
+                int cr = crOf[top[x]] + crOf[top[x + 1]] + crOf[bottom[x]] + crOf[bottom[x + 1]];
+                cbPlane[offset + x / 2] = (uint8_t)((cb + 2) / 4);
+                crPlane[offset + x / 2] = (uint8_t)((cr + 2) / 4);
+            }
+        }
+    }
+
+    void Work()
+    {
+        SoftTile tile;
+        uint64_t seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]
+                          { return quit || generation != seen; });
+                if (quit)
+                    return;
+                seen = generation;
+            }
+            for (int i; (i = nextTile.fetch_add(1, std::memory_order_relaxed)) < TILES_X * TILES_Y;)
+                RenderTile(i, tile);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0)
+                done.notify_one();
+        }
+    }
+
+    // Starts rasterizing the current primitives into `out` (FRAME_BYTES of
+    // Y, Cb, Cr planes). The primitives must stay put until Wait().
+    void Dispatch(uint8_t *out)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            target = out;
+            nextTile.store(0, std::memory_order_relaxed);
+            busy = (int)workers.size();
+            generation++;
+        }
+        wake.notify_all();
+    }
+
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]
+                  { return busy == 0; });
+    }
+};
+
+const int VIDEO_FPS = 60;
+
+// Plays `replay` from `from` seconds in (or, without one, the bot for
+// `botSeconds`) and renders it as a VIDEO_FPS y4m stream to `outPath` ("-"
+// for stdout, null to only time it). Fast-forward renders one frame per
+// `every` frames of game time and only simulates the rest. Each frame is
+// written while workers rasterize the next. Returns frames rendered, or -1
+// if the output can't be opened.
+int RenderVideo(const char *outPath, const Replay *replay, double botSeconds, int threads, double *seconds = nullptr,
+                double from = 0, int every = 1)
+{
+    FILE *out = nullptr;
+    if (outPath)
+    {
+        out = strcmp(outPath, "-") == 0 ? stdout : fopen(outPath, "wb");
+        if (!out)
+            return -1;
+        fprintf(out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", SoftRenderer::WIDTH, SoftRenderer::HEIGHT, VIDEO_FPS);
+    }
+
+    Game botGame;
+    BotController bot;
+    std::unique_ptr<ReplayPlayer> player;
+    Game *game = &botGame;
+    if (replay)
+    {
+        player = std::make_unique<ReplayPlayer>(*replay);
+        player->Seek(replay->TickAt(from));
+        game = &player->game;
+    }
+    SoftRenderer renderer(threads);
+    std::vector<uint8_t> frames[2];
+    frames[0].resize(SoftRenderer::FRAME_BYTES);
+    frames[1].resize(SoftRenderer::FRAME_BYTES);
+
+    auto write = [&](const std::vector<uint8_t> &frame)
+    {
+        if (!out)
+            return;
+        fputs("FRAME\n", out);
+        fwrite(frame.data(), 1, frame.size(), out);
+    };
+
+    double t0 = NowSeconds();
+    double simTime = player ? player->time : 0;
+    double nextFrame = simTime;
+    int count = 0;
+    for (;;)
+    {
+        bool ended = false;
+        while (simTime < nextFrame && !ended)
+        {
+            if (player)
+            {
+                ended = player->Done();
+                if (!ended)
+                {
+                    player->Step();
+                    simTime = player->time;
+                }
+            }
+            else
+            {
+                ended = simTime >= botSeconds;
+                if (!ended)
+                {
+                    frameArena.Reset();
+                    botGame.Update(1.0f / SIM_TICK_HZ, bot.Poll(botGame));
+                    simTime += 1.0 / SIM_TICK_HZ;
+                }
+            }
+        }
+        if (ended)
+            break;
+
+        renderer.Draw(*game);
+        renderer.Dispatch(frames[count & 1].data());
+        if (count > 0)
+            write(frames[(count - 1) & 1]);
+        renderer.Wait();
+        count++;
+        nextFrame += (double)std::max(1, every) / VIDEO_FPS;
+    }
+    if (count > 0)
+        write(frames[(count - 1) & 1]);
+
+    if (out && out != stdout)
+        fclose(out);
+    else if (out)
+        fflush(out);
+    if (seconds)
+        *seconds = NowSeconds() - t0;
+    return count;
+}
+#endif
+
+// --------------------------------------------------
+// Differential check
+// --------------------------------------------------
+
+// Game::HandleCollisions is the reference model for every faster collision
+// engine. `--fuzz [engine] [cases] [seed]` runs both on generated worlds
+// (uniform, piled up on the wrap seams, bullets and ship at exact tangents
+// and one ulp either side, tight clusters) and compares everything a step
+// can change. The first divergence is shrunk by dropping entities while it
+// persists and printed as a reproducer.
+
+struct CollisionEngine
+{
+    virtual ~CollisionEngine() = default;
+    virtual const char *Name() const = 0;
+    // One collision step on `game`, standing in for HandleCollisions.
+    virtual void Collide(Game &game) = 0;
+};
+
+struct ReferenceEngine : CollisionEngine
+{
+    const char *Name() const override { return "reference"; }
+    void Collide(Game &game) override { game.HandleCollisions(); }
+};
+
+// Bullets sorted by x, so each asteroid binary-searches for the few within
+// reach instead of testing them all. The first bullet in list order that
+// overlaps still takes the hit, as in the reference.
+struct SortedEngine : CollisionEngine
+{
+    std::vector<uint32_t> order;
+
+    const char *Name() const override { return "sorted"; }
+
+    void Collide(Game &game) override
+    {
+        auto &bullets = game.bullets;
+        order.resize(bullets.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&](uint32_t i, uint32_t j)
+                  { return bullets[i].pos.x < bullets[j].pos.x || (bullets[i].pos.x == bullets[j].pos.x && i < j); });
+
+        game.asteroids.Rewrite([&](Asteroid &a, SlotMap<Asteroid>::Inserter &out)
+                               {
+                                   // A pixel of slack so rounding in the squared
+                                   // distance can't hide a bullet at the edge.
+                                   float reach = a.radius + 2 + 1;
+                                   auto it = std::lower_bound(order.begin(), order.end(), a.pos.x - reach,
+                                                              [&](uint32_t i, float x)
+                                                              { return bullets[i].pos.x < x; });
+                                   uint32_t hit = UINT32_MAX;
+                                   for (; it != order.end() && bullets[*it].pos.x <= a.pos.x + reach; ++it)
+                                       if (*it < hit && CircleCollision(bullets[*it].pos, 2, a.pos, a.radius))
+                                           hit = *it;
+                                   if (hit == UINT32_MAX)
+                                       return true;
+                                   bullets[hit].life = 0;
+                                   game.Shatter(a, out);
+                                   return false; });
+        game.CheckShip();
+    }
+};
+
+// A planted bug for checking the harness itself: the reference run over the
+// asteroids in reverse, so splits draw their random numbers out of order.
+struct ReversedEngine : CollisionEngine
+{
+    const char *Name() const override { return "reversed"; }
+
+    void Collide(Game &game) override
+    {
+        game.asteroids.Reverse();
+        game.HandleCollisions();
+        game.asteroids.Reverse();
+    }
+};
+
+// Everything HandleCollisions reads.
+struct CollisionCase
+{
+    Vector2 world;
+    uint32_t rng;
+    Vector2 shipPos;
+    float invuln;
+    bool invincible;
+    std::vector<Asteroid> asteroids;
+    std::vector<Bullet> bullets;
+};
+
+// Everything it can change.
+struct CollisionOutcome
+{
+    int score, lives;
+    bool gameOver;
+    uint32_t rng;
+    Vector2 shipPos;
+    size_t effects;
+    std::vector<float> bulletLife;
+    std::vector<Asteroid> asteroids;
+
+    bool operator==(const CollisionOutcome &o) const
+    {
+        if (score != o.score || lives != o.lives || gameOver != o.gameOver || rng != o.rng ||
+            shipPos.x != o.shipPos.x || shipPos.y != o.shipPos.y || effects != o.effects ||
+            bulletLife != o.bulletLife || asteroids.size() != o.asteroids.size())
+            return false;
+        for (size_t i = 0; i < asteroids.size(); i++)
+        {
+            const Asteroid &a = asteroids[i], &b = o.asteroids[i];
+            if (a.pos.x != b.pos.x || a.pos.y != b.pos.y || a.vel.x != b.vel.x || a.vel.y != b.vel.y ||
+                a.size != b.size || a.shapeSeed != b.shapeSeed)
+                return false;
+        }
+        return true;
+    }
+};
+
+struct DifferentialCheck
+{
+    CollisionEngine &candidate;
+    ReferenceEngine reference;
+    Game game;
+    std::vector<EffectEvent> effects;
+    CollisionOutcome expected, actual;
+
+    explicit DifferentialCheck(CollisionEngine &engine) : candidate(engine)
+    {
+        game.effectLog = &effects;
+    }
+
+    void Run(CollisionEngine &engine, const CollisionCase &c, CollisionOutcome &out)
+    {
+        worldWidth = c.world.x;
+        worldHeight = c.world.y;
+        frameArena.Reset();
+        effects.clear();
+        game.asteroids.assign(c.asteroids.begin(), c.asteroids.end());
+        game.bullets.assign(c.bullets.begin(), c.bullets.end());
+        game.score = 0;
+        game.lives = LIVES_START;
+        game.gameOver = false;
+        game.player.Reset();
+        game.player.pos = c.shipPos;
+        game.player.invuln = c.invuln;
+        game.invincible = c.invincible;
+        rngState = c.rng;
+
+        engine.Collide(game);
+
+        out.score = game.score;
+        out.lives = game.lives;
+        out.gameOver = game.gameOver;
+        out.rng = rngState;
+        out.shipPos = game.player.pos;
+        out.effects = effects.size();
+        out.bulletLife.clear();
+        for (auto &b : game.bullets)
+            out.bulletLife.push_back(b.life);
+        out.asteroids.assign(game.asteroids.begin(), game.asteroids.end());
+    }
+
+    bool Diverges(const CollisionCase &c)
+    {
+        Run(reference, c, expected);
+        Run(candidate, c, actual);
+        return !(expected == actual);
+    }
+
+    // Greedily drops asteroids and bullets while the divergence survives.
+    void Shrink(CollisionCase &c)
+    {
+        for (bool progress = true; progress;)
+        {
+            progress = false;
+            for (size_t i = c.asteroids.size(); i-- > 0;)
+            {
+                CollisionCase smaller = c;
+                smaller.asteroids.erase(smaller.asteroids.begin() + i);
+                if (Diverges(smaller))
+                {
+                    c = smaller;
+                    progress = true;
+                }
+            }
+            for (size_t i = c.bullets.size(); i-- > 0;)
+            {
+                CollisionCase smaller = c;
+                smaller.bullets.erase(smaller.bullets.begin() + i);
+                if (Diverges(smaller))
+                {
+                    c = smaller;
+                    progress = true;
+                }
+            }
+        }
+        Diverges(c); // leave expected/actual describing the final case
+    }
+};
+
+float FuzzRange(uint32_t &state, float lo, float hi)
+{
+    return lo + (float)(NextRandom(state) >> 8) / 16777216.0f * (hi - lo);
+}
+
+// One random world. Tangent cases use whole-number positions so the exact
+// contact distance is representable, then sometimes nudge a coordinate one
+// ulp either way.
+void RandomCollisionCase(uint32_t &state, CollisionCase &c)
+{
+    const Vector2 WORLDS[] = {{(float)SCREEN_WIDTH, (float)SCREEN_HEIGHT}, {64, 64}, {3000, 2000}};
+    c.world = WORLDS[NextRandom(state) % 3];
+    c.rng = NextRandom(state) | 1;
+    c.invuln = NextRandom(state) % 2 ? 0 : 1;
+    c.invincible = NextRandom(state) % 8 == 0;
+    c.asteroids.clear();
+    c.bullets.clear();
+
+    int kind = NextRandom(state) % 4;
+    int asteroidCount = NextRandom(state) % 25;
+    int bulletCount = NextRandom(state) % 13;
+    Vector2 cluster = {FuzzRange(state, 0, c.world.x), FuzzRange(state, 0, c.world.y)};
+    auto place = [&]() -> Vector2
+    {
+        switch (kind)
+        {
+        case 1: // on or near the seams, including exactly 0 and the far edge
+        {
+            float edgeX = NextRandom(state) % 2 ? 0 : c.world.x;
+            float edgeY = NextRandom(state) % 2 ? 0 : c.world.y;
+            float x = NextRandom(state) % 4 == 0 ? edgeX : fmodf(edgeX + FuzzRange(state, -50, 50) + c.world.x, c.world.x);
+            float y = NextRandom(state) % 4 == 0 ? edgeY : fmodf(edgeY + FuzzRange(state, -50, 50) + c.world.y, c.world.y);
+            return {x, y};
+        }
+        case 2: // whole numbers, for exact tangents
+            return {(float)(NextRandom(state) % (uint32_t)c.world.x), (float)(NextRandom(state) % (uint32_t)c.world.y)};
+        case 3:
+            return {cluster.x + FuzzRange(state, -60, 60), cluster.y + FuzzRange(state, -60, 60)};
+        default:
+            return {FuzzRange(state, 0, c.world.x), FuzzRange(state, 0, c.world.y)};
+        }
+    };
+    auto nudge = [&](float v)
+    {
+        uint32_t r = NextRandom(state) % 4;
+        return r == 0 ? nextafterf(v, INFINITY) : r == 1 ? nextafterf(v, -INFINITY)
+                                                         : v;
+    };
+
+    for (int i = 0; i < asteroidCount; i++)
+    {
+        int size = 1 + NextRandom(state) % 3;
+        Vector2 vel = {FuzzRange(state, -100, 100), FuzzRange(state, -100, 100)};
+        c.asteroids.emplace_back(place(), vel, size, NextRandom(state));
+    }
+    for (int i = 0; i < bulletCount; i++)
+    {
+        Vector2 pos = place();
+        if (kind == 2 && !c.asteroids.empty())
+        {
+            // Exactly bullet radius + asteroid radius away along an axis.
+            const Asteroid &a = c.asteroids[NextRandom(state) % c.asteroids.size()];
+            float d = (2 + a.radius) * (NextRandom(state) % 2 ? 1 : -1);
+            pos = NextRandom(state) % 2 ? Vector2{nudge(a.pos.x + d), a.pos.y} : Vector2{a.pos.x, nudge(a.pos.y + d)};
+        }
+        c.bullets.emplace_back(pos, Vector2{0, 0});
+    }
+    c.shipPos = place();
+    if (kind == 2 && !c.asteroids.empty())
+    {
+        // A small asteroid touches the ship at offset (10, 24), a 10-24-26
+        // triangle; other sizes along an axis.
+        const Asteroid &a = c.asteroids[NextRandom(state) % c.asteroids.size()];
+        float d = SHIP_RADIUS + a.radius;
+        c.shipPos = a.size == 1 ? Vector2{a.pos.x + 10, a.pos.y + 24} : Vector2{a.pos.x + d, a.pos.y};
+        c.shipPos.x = nudge(c.shipPos.x);
+    }
+}
+
+void PrintOutcome(const char *name, const CollisionOutcome &o)
+{
+    printf("  %-9s score %d, lives %d%s, rng %08x, %zu effects, ship (%.9g, %.9g)\n", name, o.score, o.lives,
+           o.gameOver ? " (game over)" : "", o.rng, o.effects, o.shipPos.x, o.shipPos.y);
+    printf("            bullets spent:");
+    for (size_t i = 0; i < o.bulletLife.size(); i++)
+        if (o.bulletLife[i] <= 0)
+            printf(" %zu", i);
+    printf("\n");
+    for (auto &a : o.asteroids)
+        printf("            size %d at (%.9g, %.9g) vel (%.9g, %.9g) seed %08x\n", a.size, a.pos.x, a.pos.y, a.vel.x,
+               a.vel.y, a.shapeSeed);
+}
+
+int RunFuzz(const char *engineName, long long cases, uint32_t seed)
+{
+    SortedEngine sorted;
+    ReversedEngine reversed;
+    CollisionEngine *engine = strcmp(engineName, "sorted") == 0     ? (CollisionEngine *)&sorted
+                              : strcmp(engineName, "reversed") == 0 ? (CollisionEngine *)&reversed
+                                                                    : nullptr;
+    if (!engine)
+    {
+        fprintf(stderr, "fuzz: unknown engine %s (sorted, reversed)\n", engineName);
+        return 1;
+    }
+
+    float savedW = worldWidth, savedH = worldHeight;
+    DifferentialCheck check(*engine);
+    CollisionCase c;
+    uint32_t state = seed ? seed : 1;
+    double t0 = NowSeconds();
+    long long hits = 0;
+    printf("fuzz: %s against reference, %lld cases from seed %u\n", engine->Name(), cases, seed);
+    for (long long i = 0; i < cases; i++)
+    {
+        RandomCollisionCase(state, c);
+        if (!check.Diverges(c))
+        {
+            hits += check.expected.effects > 0;
+            continue;
+        }
+
+        size_t asteroids = c.asteroids.size(), bullets = c.bullets.size();
+        check.Shrink(c);
+        printf("DIVERGENCE at case %lld, shrunk from %zu asteroids and %zu bullets:\n", i, asteroids, bullets);
+        printf("  world %.9gx%.9g, rng %08x, ship (%.9g, %.9g) invuln %g%s\n", c.world.x, c.world.y, c.rng,
+               c.shipPos.x, c.shipPos.y, c.invuln, c.invincible ? ", invincible" : "");
+        for (auto &a : c.asteroids)
+            printf("  asteroid size %d at (%.9g, %.9g) vel (%.9g, %.9g) seed %08x\n", a.size, a.pos.x, a.pos.y,
+                   a.vel.x, a.vel.y, a.shapeSeed);
+        for (size_t k = 0; k < c.bullets.size(); k++)
+            printf("  bullet %zu at (%.9g, %.9g)\n", k, c.bullets[k].pos.x, c.bullets[k].pos.y);
+        PrintOutcome("reference", check.expected);
+        PrintOutcome(engine->Name(), check.actual);
+        worldWidth = savedW;
+        worldHeight = savedH;
+        return 1;
+    }
+    double elapsed = NowSeconds() - t0;
+    printf("  no divergence in %lld cases (%lld with a collision), %.1f s, %.0f cases/s\n", cases, hits, elapsed,
+           cases / elapsed);
+    worldWidth = savedW;
+    worldHeight = savedH;
+    return 0;
+}
+
+// --------------------------------------------------
+// Benchmarks
+// --------------------------------------------------
+
+// Headless micro-benchmarks, run with `--bench <name>`. None of them open a
+// window.
+
+void FillBenchWorld(Game &g, int asteroidCount, int bulletCount)
+{
+    g.asteroids.clear();
+    g.bullets.clear();
+    for (int i = 0; i < asteroidCount; i++)
+        g.asteroids.emplace_back(Vector2{RandomRange(0, worldWidth), RandomRange(0, worldHeight)}, 1 + i % 3);
+    for (int i = 0; i < bulletCount; i++)
+        g.bullets.emplace_back(Vector2{RandomRange(0, worldWidth), RandomRange(0, worldHeight)},
+                               VecScale(VecFromAngle(RandomRange(0, PI * 2)), BULLET_SPEED));
+}
+
+int BenchSnapshot()
+{
+    const int ITERATIONS = 2000;
+    const float dt = 1.0f / 60.0f;
+
+    Game g;
+    FillBenchWorld(g, 800, 200);
+
+    size_t cap = g.SnapshotSize();
+    std::vector<uint8_t> prev(cap), cur(cap), delta(cap * 2), decoded(cap);
+    size_t prevLen = g.WriteSnapshot(prev.data(), cap);
+
+    double writeTime = 0, deltaTime = 0, readTime = 0;
+    size_t fullBytes = 0, deltaBytes = 0;
+    int mismatches = 0;
+    Game restored;
+
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        for (auto &a : g.asteroids)
+            a.Update(dt);
+        for (auto &b : g.bullets)
+            b.Update(dt);
+
+        double t0 = NowSeconds();
+        size_t curLen = g.WriteSnapshot(cur.data(), cap);
+        double t1 = NowSeconds();
+        size_t deltaLen = EncodeSnapshotDelta(prev.data(), prevLen, cur.data(), curLen, delta.data(), delta.size());
+        double t2 = NowSeconds();
+        restored.ReadSnapshot(cur.data(), curLen);
+        double t3 = NowSeconds();
+
+        size_t decodedLen = DecodeSnapshotDelta(prev.data(), prevLen, delta.data(), deltaLen, decoded.data(), cap);
+        if (decodedLen != curLen || memcmp(decoded.data(), cur.data(), curLen) != 0)
+            mismatches++;
+
+        writeTime += t1 - t0;
+        deltaTime += t2 - t1;
+        readTime += t3 - t2;
+        fullBytes += curLen;
+        deltaBytes += deltaLen;
+        std::swap(prev, cur);
+        prevLen = curLen;
+    }
+
+    printf("snapshot: %zu asteroids + %zu bullets, %d iterations\n", g.asteroids.size(), g.bullets.size(), ITERATIONS);
+    printf("  full snapshot  %8zu bytes  %8.0f ns\n", fullBytes / ITERATIONS, writeTime / ITERATIONS * 1e9);
+    printf("  delta encode   %8zu bytes  %8.0f ns\n", deltaBytes / ITERATIONS, deltaTime / ITERATIONS * 1e9);
+    printf("  restore                       %8.0f ns\n", readTime / ITERATIONS * 1e9);
+    printf("  delta round-trip mismatches: %d\n", mismatches);
+
+    // Malformed input must be refused with the game left as it was: an
+    // asteroid size outside 1..3, and a count the bytes can't hold.
+    size_t before = restored.asteroids.size();
+    int accepted = 0;
+    std::vector<uint8_t> bad(prev.begin(), prev.begin() + prevLen);
+    size_t firstSize = SNAPSHOT_HEADER_BYTES + g.bullets.size() * SNAPSHOT_BULLET_BYTES + 4 * 4;
+    for (uint8_t size : {0, 4, 255})
+    {
+        bad[firstSize] = size;
+        accepted += restored.ReadSnapshot(bad.data(), bad.size());
+    }
+    bad[firstSize] = prev[firstSize];
+    uint32_t huge = 0x40000000;
+    memcpy(&bad[SNAPSHOT_HEADER_BYTES - 4], &huge, 4);
+    accepted += restored.ReadSnapshot(bad.data(), bad.size());
+    if (restored.asteroids.size() != before)
+        accepted++;
+    printf("  malformed snapshots accepted: %d\n", accepted);
+    return mismatches == 0 && accepted == 0 ? 0 : 1;
+}
+
+size_t ResidentBytes()
+{
+#if defined(__linux__) && defined(ZAYDROIDS_NET)
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f)
+    {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(f);
+    }
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+// Runs `games` bot-driven games headless at a fixed dt until `waves` waves
+// have been cleared in total, printing tick cost and resident memory as it
+// goes so drift and leaks show up over long runs.
+int RunSoak(int games, int waves, EventLog *log)
+{
+    const float dt = 1.0f / 60.0f;
+    const int REPORT_TICKS = 3600;
+
+    std::vector<Game> sims(games);
+    std::vector<BotController> bots(games);
+    std::vector<int> lastWave(games, 1);
+    if (log)
+    {
+        for (auto &g : sims)
+        {
+            g.eventLog = log;
+            g.Reset();
+        }
+    }
+
+    long long cleared = 0;
+    long long tick = 0;
+    double firstCost = 0, lastCost = 0;
+    size_t firstRss = 0, lastRss = 0;
+    double intervalStart = NowSeconds();
+
+    printf("soak: %d games until %d waves cleared\n", games, waves);
+    while (cleared < waves)
+    {
+        frameArena.Reset();
+        for (int i = 0; i < games; i++)
+        {
+            Game &g = sims[i];
+            g.Update(dt, bots[i].Poll(g));
+            if (g.wave > lastWave[i])
+                cleared += g.wave - lastWave[i];
+            lastWave[i] = g.wave;
+        }
+        tick++;
+
+        if (tick % REPORT_TICKS == 0)
+        {
+            double now = NowSeconds();
+            double cost = (now - intervalStart) / REPORT_TICKS / games;
+            size_t rss = ResidentBytes();
+            if (firstCost == 0)
+            {
+                firstCost = cost;
+                firstRss = rss;
+            }
+            lastCost = cost;
+            lastRss = rss;
+            printf("  tick %8lld  waves %7lld  %8.2f us/game-tick  rss %7.2f MiB\n",
+                   tick, cleared, cost * 1e6, rss / 1048576.0);
+            fflush(stdout);
+            intervalStart = now;
+        }
+    }
+
+    if (firstCost > 0)
+        printf("soak: tick cost drift %+.1f%%, rss growth %+.2f MiB\n",
+               (lastCost / firstCost - 1) * 100, ((double)lastRss - (double)firstRss) / 1048576.0);
+    return 0;
+}
+
+// Asteroid update cost at 100k asteroids in a 20000x20000 world, with and
+// without simulation LOD, plus how far LOD positions stray near the ship.
+int BenchLod()
+{
+    const int COUNT = 100000;
+    const int TICKS = 600;
+    const float dt = 1.0f / 60.0f;
+
+    worldWidth = 20000;
+    worldHeight = 20000;
+
+    Game games[2];
+    for (int mode = 0; mode < 2; mode++)
+    {
+        SeedRandom(1234);
+        games[mode].simLod = mode == 1;
+        games[mode].player.Reset();
+        games[mode].player.vel = {300, 120};
+        FillBenchWorld(games[mode], COUNT, 0);
+    }
+
+    double cost[2];
+    for (int mode = 0; mode < 2; mode++)
+    {
+        Game &g = games[mode];
+        double total = 0;
+        for (int t = 0; t < TICKS; t++)
+        {
+            g.player.Update(dt, PlayerInput());
+            double t0 = NowSeconds();
+            g.UpdateAsteroids(dt);
+            total += NowSeconds() - t0;
+        }
+        cost[mode] = total / TICKS;
+    }
+
+    float maxError = 0;
+    int near = 0;
+    for (int i = 0; i < COUNT; i++)
+    {
+        const Asteroid &exact = games[0].asteroids[i];
+        const Asteroid &lod = games[1].asteroids[i];
+        if (VecLen(WrapDelta(games[0].player.pos, exact.pos)) > LOD_ACTIVE_RADIUS)
+            continue;
+        near++;
+        maxError = std::max(maxError, VecLen(WrapDelta(exact.pos, lod.pos)));
+    }
+
+    printf("lod: %d asteroids, %d ticks, world %.0fx%.0f\n", COUNT, TICKS, worldWidth, worldHeight);
+    printf("  full rate   %8.1f us/tick\n", cost[0] * 1e6);
+    printf("  with LOD    %8.1f us/tick  (%.1fx)\n", cost[1] * 1e6, cost[0] / cost[1]);
+    printf("  %d asteroids inside the active radius, max position error %.4f px\n", near, maxError);
+    return 0;
+}
+
+// Drives a bot game headless and counts heap allocations per tick. Ticks
+// that spawn a wave or restart are reported separately; every other tick is
+// expected to allocate nothing. Needs a -DZAYDROIDS_COUNT_ALLOCS build.
+int BenchAllocs()
+{
+#ifndef ZAYDROIDS_COUNT_ALLOCS
+    printf("allocs: rebuild with -DZAYDROIDS_COUNT_ALLOCS to count heap allocations\n");
+    return 0;
+#else
+    const int WARMUP = 600;
+    const int TICKS = 60000;
+    const float dt = 1.0f / 60.0f;
+
+    Game g;
+    BotController bot;
+    int steadyTicks = 0, steadyDirty = 0, spawnTicks = 0;
+    uint64_t steadyAllocs = 0, spawnAllocs = 0;
+
+    for (int t = 0; t < WARMUP + TICKS; t++)
+    {
+        frameArena.Reset();
+        int wave = g.wave;
+        bool over = g.gameOver;
+        uint64_t before = HeapAllocations();
+        g.Update(dt, bot.Poll(g));
+        uint64_t n = HeapAllocations() - before;
+        if (t < WARMUP)
+            continue;
+
+        if (g.wave != wave || g.gameOver != over)
+        {
+            spawnTicks++;
+            spawnAllocs += n;
+        }
+        else
+        {
+            steadyTicks++;
+            steadyAllocs += n;
+            steadyDirty += n > 0;
+        }
+    }
+
+    printf("allocs: %d ticks after %d warm-up\n", TICKS, WARMUP);
+    printf("  steady ticks   %6d  allocations %llu  (%d ticks allocated)\n", steadyTicks, (unsigned long long)steadyAllocs, steadyDirty);
+    printf("  spawn/restart  %6d  allocations %llu\n", spawnTicks, (unsigned long long)spawnAllocs);
+    return steadyAllocs == 0 ? 0 : 1;
+#endif
+}
+
+// 100k saturated particles: SIMD vs scalar integration, plus the CPU side
+// of drawing them (culling, fading and building quad vertices), then the
+// budget knob reacting to an over-budget frame.
+int BenchParticles()
+{
+    const int COUNT = 100000;
+    const int FRAMES = 300;
+    const float dt = 1.0f / 60.0f;
+
+    worldWidth = 4000;
+    worldHeight = 4000;
+    ParticlePool pool(COUNT);
+    for (int i = 0; i < COUNT / 100; i++)
+        pool.Emit({RandomRange(0, worldWidth), RandomRange(0, worldHeight)}, {0, 0}, 100, 200, 1000, LIGHTGRAY);
+
+    View view = View::Follow({worldWidth / 2, worldHeight / 2});
+    view.halfW = worldWidth / 2;
+    view.halfH = worldHeight / 2;
+    std::vector<float> vertices((size_t)COUNT * 8);
+
+    double simd = 0, scalar = 0, gather = 0, build = 0;
+    int drawn = 0;
+    for (int f = 0; f < FRAMES; f++)
+    {
+        double t0 = NowSeconds();
+        pool.Integrate(0, pool.used, dt, 0.99f);
+        double t1 = NowSeconds();
+        pool.IntegrateScalar(0, pool.used, -dt, 1 / 0.99f);
+        double t2 = NowSeconds();
+        drawn = pool.Gather(view);
+        double t3 = NowSeconds();
+        for (int i = 0; i < drawn; i++)
+        {
+            float px = pool.outX[i], py = pool.outY[i], h = PARTICLE_SIZE / 2;
+            float *v = &vertices[(size_t)i * 8];
+            v[0] = px - h, v[1] = py - h, v[2] = px - h, v[3] = py + h;
+            v[4] = px + h, v[5] = py + h, v[6] = px + h, v[7] = py - h;
+        }
+        double t4 = NowSeconds();
+        simd += t1 - t0;
+        scalar += t2 - t1;
+        gather += t3 - t2;
+        build += t4 - t3;
+    }
+
+    printf("particles: %d live, %d frames\n", COUNT, FRAMES);
+#if defined(__SSE2__)
+    printf("  integrate SSE2    %8.1f us/frame  %6.2f ns/particle\n", simd / FRAMES * 1e6, simd / FRAMES / COUNT * 1e9);
+#else
+    printf("  integrate (no SSE2 in this build, same as scalar) %8.1f us/frame\n", simd / FRAMES * 1e6);
+#endif
+    printf("  integrate scalar  %8.1f us/frame  %6.2f ns/particle\n", scalar / FRAMES * 1e6, scalar / FRAMES / COUNT * 1e9);
+    printf("  cull + fade       %8.1f us/frame  (%d visible)\n", gather / FRAMES * 1e6, drawn);
+    printf("  quad vertices     %8.1f us/frame\n", build / FRAMES * 1e6);
+
+    // Pretend the frame is over budget and watch emission back off.
+    pool.budgetSeconds = (simd + gather + build) / FRAMES / 4;
+    for (int f = 0; f < 20; f++)
+    {
+        pool.drawTime = (gather + build) / FRAMES;
+        pool.Update(dt);
+    }
+    printf("  budget %.0f us: emission scale fell to %.2f\n", pool.budgetSeconds * 1e6, pool.scale);
+    return 0;
+}
+
+// CPU side of drawing a frame: cull every entity against the view and build
+// its line vertices, as Draw would hand them to raylib.
+size_t BuildFrameVertices(const Game &g, const View &view, std::vector<Vector2> &out)
+{
+    out.clear();
+    for (auto &a : g.asteroids)
+    {
+        Vector2 at = view.Nearest(a.pos);
+        if (!view.Visible(at, a.radius * 1.1f))
+            continue;
+        for (int i = 0; i < a.pointCount; i++)
+        {
+            out.push_back(VecAdd(at, a.points[i]));
+            out.push_back(VecAdd(at, a.points[(i + 1) % a.pointCount]));
+        }
+    }
+    for (auto &b : g.bullets)
+    {
+        Vector2 at = view.Nearest(b.pos);
+        if (view.Visible(at, 2))
+            out.push_back(at);
+    }
+    return out.size();
+}
+
+// --bounce cost from 1k to 20k asteroids at a constant density (about the
+// normal game's, so contacts per asteroid stay the same). Before timing,
+// the sweep's candidate pairs are checked against every touching pair an
+// all-pairs test finds, seams included.
+int BenchBounce()
+{
+    const int COUNTS[] = {100, 1000, 2000, 5000, 10000, 20000};
+    const int TICKS = 300;
+    const float dt = 1.0f / 60.0f;
+    const float AREA_PER_ASTEROID = 16000;
+    float savedW = worldWidth, savedH = worldHeight;
+
+    printf("bounce: %d ticks, %.0f px^2 per asteroid\n", TICKS, AREA_PER_ASTEROID);
+    printf("  asteroids   us/tick  ns/asteroid  sort swaps  pairs tested  contacts  energy drift\n");
+    int failures = 0;
+    for (int count : COUNTS)
+    {
+        worldWidth = worldHeight = floorf(sqrtf(count * AREA_PER_ASTEROID));
+        SeedRandom(2024);
+        Game g;
+        FillBenchWorld(g, count, 0);
+
+        AsteroidSweep check;
+        check.Sort(g.asteroids);
+        size_t found = 0, touching = 0;
+        check.ForEachPair([&](uint32_t i, uint32_t j)
+                          {
+                              Vector2 d = WrapDelta(g.asteroids[i].pos, g.asteroids[j].pos);
+                              float reach = g.asteroids[i].radius + g.asteroids[j].radius;
+                              found += d.x * d.x + d.y * d.y < reach * reach; });
+        if (count <= 5000)
+        {
+            for (int i = 0; i < count; i++)
+                for (int j = i + 1; j < count; j++)
+                {
+                    Vector2 d = WrapDelta(g.asteroids[i].pos, g.asteroids[j].pos);
+                    float reach = g.asteroids[i].radius + g.asteroids[j].radius;
+                    touching += d.x * d.x + d.y * d.y < reach * reach;
+                }
+            if (found != touching)
+            {
+                printf("  %9d  broadphase found %zu touching pairs, all-pairs %zu\n", count, found, touching);
+                failures++;
+            }
+        }
+
+        auto energy = [&]
+        {
+            double e = 0;
+            for (auto &a : g.asteroids)
+                e += 0.5 * ASTEROID_MASS[a.size] * (a.vel.x * a.vel.x + a.vel.y * a.vel.y);
+            return e;
+        };
+        double before = energy();
+        double time = 0;
+        size_t swaps = 0, tested = 0, contacts = 0;
+        for (int t = 0; t < TICKS; t++)
+        {
+            for (auto &a : g.asteroids)
+                a.Update(dt);
+            double t0 = NowSeconds();
+            g.sweep.Resolve(g.asteroids);
+            time += NowSeconds() - t0;
+            if (t > 0) // the first tick is the initial full sort
+                swaps += g.sweep.swaps;
+            tested += g.sweep.tested;
+            contacts += g.sweep.contacts;
+        }
+        printf("  %9d  %8.1f  %11.1f  %10.1f  %12.1f  %8.1f  %+11.4f%%\n", count, time / TICKS * 1e6,
+               time / TICKS / count * 1e9, (double)swaps / (TICKS - 1), (double)tested / TICKS,
+               (double)contacts / TICKS, (energy() / before - 1) * 100);
+    }
+
+    // Insertion sort over a coherent order against sorting from scratch.
+    AsteroidSweep last;
+    SeedRandom(7);
+    Game g;
+    worldWidth = worldHeight = floorf(sqrtf(10000 * AREA_PER_ASTEROID));
+    FillBenchWorld(g, 10000, 0);
+    last.Sort(g.asteroids);
+    double insertion = 0, full = 0;
+    for (int t = 0; t < TICKS; t++)
+    {
+        for (auto &a : g.asteroids)
+            a.Update(dt);
+        double t0 = NowSeconds();
+        last.Sort(g.asteroids);
+        double t1 = NowSeconds();
+        std::vector<AsteroidSweep::Entry> scratch = last.order;
+        std::reverse(scratch.begin(), scratch.end());
+        double t2 = NowSeconds();
+        std::sort(scratch.begin(), scratch.end(), AsteroidSweep::Before);
+        insertion += t1 - t0;
+        full += NowSeconds() - t2;
+    }
+    printf("  10k sort: insertion (coherent) %.1f us/tick, std::sort from scratch %.1f us/tick\n",
+           insertion / TICKS * 1e6, full / TICKS * 1e6);
+
+    worldWidth = savedW;
+    worldHeight = savedH;
+    return failures ? 1 : 0;
+}
+
+// Generational handles: lookup through a handle against indexing a vector
+// and against searching for the entity, iteration against a plain vector,
+// then stale handles through removal, slot reuse and a long bot game.
+int BenchSlotMap()
+{
+    const int COUNT = 100000;
+    const int LOOKUPS = 1000000;
+    const int SEARCHES = 200;
+    const int REPS = 50;
+    const int GAME_TICKS = 20000;
+    const float dt = 1.0f / 60.0f;
+    typedef SlotMap<Asteroid>::Handle Handle;
+    int failures = 0;
+
+    float savedW = worldWidth, savedH = worldHeight;
+    worldWidth = worldHeight = 20000;
+    SeedRandom(5);
+    std::vector<Asteroid> plain;
+    SlotMap<Asteroid> map;
+    std::vector<Handle> handles;
+    for (int i = 0; i < COUNT; i++)
+    {
+        plain.emplace_back(Vector2{RandomRange(0, worldWidth), RandomRange(0, worldHeight)}, 1 + i % 3);
+        map.push_back(plain.back());
+        handles.push_back(map.HandleAt(i));
+    }
+
+    std::vector<uint32_t> picks(LOOKUPS);
+    uint32_t state = 77;
+    for (auto &p : picks)
+        p = NextRandom(state) % COUNT;
+
+    double t0 = NowSeconds();
+    float byIndex = 0;
+    for (uint32_t p : picks)
+        byIndex += plain[p].radius;
+    double t1 = NowSeconds();
+    float byHandle = 0;
+    for (uint32_t p : picks)
+        byHandle += map.Get(handles[p])->radius;
+    double t2 = NowSeconds();
+    float bySearch = 0;
+    for (int i = 0; i < SEARCHES; i++)
+    {
+        uint32_t seed = plain[picks[i]].shapeSeed;
+        bySearch += std::find_if(plain.begin(), plain.end(), [&](const Asteroid &a)
+                                 { return a.shapeSeed == seed; })
+                        ->radius;
+    }
+    double t3 = NowSeconds();
+    if (byIndex != byHandle || bySearch <= 0)
+        failures++;
+
+    double plainIter = 0, mapIter = 0;
+    for (int r = 0; r < REPS; r++)
+    {
+        double s0 = NowSeconds();
+        for (auto &a : plain)
+            a.Update(dt);
+        double s1 = NowSeconds();
+        for (auto &a : map)
+            a.Update(dt);
+        plainIter += s1 - s0;
+        mapIter += NowSeconds() - s1;
+    }
+
+    printf("slotmap: %dk asteroids\n", COUNT / 1000);
+    printf("  lookup    vector index %6.2f ns   handle %6.2f ns   linear search %9.0f ns\n",
+           (t1 - t0) / LOOKUPS * 1e9, (t2 - t1) / LOOKUPS * 1e9, (t3 - t2) / SEARCHES * 1e9);
+    printf("  iterate   vector       %6.2f ns   slot map %4.2f ns per asteroid\n",
+           plainIter / REPS / COUNT * 1e9, mapIter / REPS / COUNT * 1e9);
+
+    // Remove about half, then refill the freed slots.
+    map.RemoveIf([](const Asteroid &a)
+                 { return a.shapeSeed & 1; });
+    int stale = 0, wrong = 0;
+    for (int i = 0; i < COUNT; i++)
+    {
+        const Asteroid *a = map.Get(handles[i]);
+        bool removed = plain[i].shapeSeed & 1;
+        stale += removed && !a;
+        wrong += removed ? a != nullptr : !a || a->shapeSeed != plain[i].shapeSeed;
+    }
+    size_t kept = map.size();
+    for (size_t i = kept; i < (size_t)COUNT; i++)
+        map.emplace_back(Vector2{0, 0}, 1);
+    for (int i = 0; i < COUNT; i++)
+    {
+        const Asteroid *a = map.Get(handles[i]);
+        wrong += (plain[i].shapeSeed & 1) ? a != nullptr : !a || a->shapeSeed != plain[i].shapeSeed;
+    }
+    printf("  removed %d, all %d stale after removal and after %zu slots were reused: %s\n", COUNT - (int)kept,
+           stale, (size_t)COUNT - kept, wrong ? "NO" : "yes");
+    failures += wrong;
+    worldWidth = savedW;
+    worldHeight = savedH;
+
+    // A bot game holding a handle to every asteroid of each wave: each must
+    // find its own asteroid until it is shot, and nothing after.
+    SeedRandom(3);
+    Game g;
+    BotController bot;
+    std::vector<std::pair<Handle, uint32_t>> tracked;
+    size_t followed = 0, died = 0;
+    int gameWrong = 0;
+    int wave = 0;
+    for (int t = 0; t < GAME_TICKS; t++)
+    {
+        frameArena.Reset();
+        if (g.wave != wave)
+        {
+            wave = g.wave;
+            for (size_t i = 0; i < g.asteroids.size(); i++)
+                tracked.push_back({g.asteroids.HandleAt(i), g.asteroids[i].shapeSeed});
+            followed += g.asteroids.size();
+        }
+        g.Update(dt, bot.Poll(g));
+
+        for (size_t i = 0; i < tracked.size();)
+        {
+            const Asteroid *a = g.asteroids.Get(tracked[i].first);
+            if (a)
+            {
+                gameWrong += a->shapeSeed != tracked[i].second;
+                i++;
+                continue;
+            }
+            gameWrong += std::any_of(g.asteroids.begin(), g.asteroids.end(), [&](const Asteroid &b)
+                                     { return b.shapeSeed == tracked[i].second; });
+            died++;
+            tracked[i] = tracked.back();
+            tracked.pop_back();
+        }
+        for (size_t i = 0; i < g.asteroids.size(); i++)
+            gameWrong += g.asteroids.Get(g.asteroids.HandleAt(i)) != &g.asteroids[i];
+    }
+    printf("  bot game, %d ticks: %zu large asteroids followed by handle, %zu shot and gone stale, %d mismatches\n",
+           GAME_TICKS, followed, died, gameWrong);
+    failures += gameWrong;
+    return failures ? 1 : 0;
+}
+
+// FastSinCos against double-precision libm over a dense sweep (the
+// documented error bounds are the pass/fail line), then per-call cost of
+// the trig variants and of the cached ship direction and friction factor
+// against recomputing them.
+int BenchFastMath()
+{
+    struct Range
+    {
+        float limit;
+        double bound;
+    };
+    const Range ranges[] = {{PI * 2, 2e-7}, {1000, 2e-7}, {100000, 2e-6}};
+    const int SAMPLES = 2000000;
+    bool ok = true;
+
+    printf("fastmath: max abs error vs double sin/cos, %d samples per range\n", SAMPLES);
+    for (auto &range : ranges)
+    {
+        double fastErr = 0, libmErr = 0;
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            float a = -range.limit + 2 * range.limit * (float)i / (SAMPLES - 1);
+            float fs, fc, ls, lc;
+            FastSinCos(a, &fs, &fc);
+            SinCos(a, &ls, &lc);
+            double s = sin((double)a), c = cos((double)a);
+            fastErr = std::max(fastErr, std::max(fabs(fs - s), fabs(fc - c)));
+            libmErr = std::max(libmErr, std::max(fabs(ls - s), fabs(lc - c)));
+        }
+        bool pass = fastErr <= range.bound;
+        ok = ok && pass;
+        printf("  |a| <= %-8g fast %.2e (bound %.0e, %s)  libm sincosf %.2e\n", range.limit, fastErr, range.bound,
+               pass ? "ok" : "FAIL", libmErr);
+    }
+
+    const int CALLS = 4000000;
+    std::vector<float> angles(4096);
+    for (auto &a : angles)
+        a = RandomRange(-PI * 4, PI * 4);
+    std::vector<float> out(4096);
+    volatile float sink = 0;
+    auto time = [&](auto &&f)
+    {
+        double t0 = NowSeconds();
+        for (int i = 0; i < CALLS; i++)
+            out[i & 4095] = f(angles[i & 4095]);
+        double t = NowSeconds() - t0;
+        sink = out[CALLS & 4095];
+        return t / CALLS * 1e9;
+    };
+
+    double separate = time([](float a)
+                           { return cosf(a) + sinf(a) * 0.5f; });
+    double joint = time([](float a)
+                        { Vector2 v = VecFromAngle(a); return v.x + v.y * 0.5f; });
+    double fast = time([](float a)
+                       { Vector2 v = FastVecFromAngle(a); return v.x + v.y * 0.5f; });
+    printf("  cosf + sinf      %6.2f ns/call\n", separate);
+    printf("  SinCos           %6.2f ns/call\n", joint);
+    printf("  FastSinCos       %6.2f ns/call\n", fast);
+
+    // Ship vectors for one frame: three VecFromAngle as Draw used to do, and
+    // the cached direction plus two fixed rotations it does now.
+    Player p;
+    double recompute = time([](float a)
+                            {
+                                Vector2 d = VecFromAngle(a), r = VecFromAngle(a + 2.5f), l = VecFromAngle(a - 2.5f);
+                                return d.x + r.y + l.x; });
+    int turn = 0;
+    double cached = time([&](float a)
+                         {
+                             // The ship turns on one frame in 8.
+                             if ((++turn & 7) == 0)
+                                 p.angle = a;
+                             Vector2 d = p.Dir();
+                             Vector2 r = VecRotate(d, -0.80114362f, 0.59847214f), l = VecRotate(d, -0.80114362f, -0.59847214f);
+                             return d.x + r.y + l.x; });
+    printf("  ship vectors     %6.2f ns recomputed, %6.2f ns cached\n", recompute, cached);
+
+    // dt comes through a volatile so powf can't be folded at compile time.
+    static volatile float tick = 1.0f / 60;
+    const float dt = tick;
+    double frictionCached = time([&](float a)
+                                 {
+                                     p.vel = {a, a};
+                                     p.Update(dt, PlayerInput());
+                                     return p.vel.x; });
+    double frictionPow = time([&](float a)
+                              {
+                                  p.vel = {a, a};
+                                  p.frictionDt = -1;
+                                  p.Update(dt, PlayerInput());
+                                  return p.vel.x; });
+    printf("  Player::Update   %6.2f ns cached friction, %6.2f ns with powf\n", frictionCached, frictionPow);
+    return ok ? 0 : 1;
+}
+
+#ifdef ZAYDROIDS_THREADS
+// Serial update-then-draw against the sim on its own thread handing frames
+// over through the triple buffer, one frame in flight. The render side here
+// is the CPU half of a frame (taking the frame plus vertex building over the
+// whole world), since there is no GPU in a headless run.
+int BenchThreads()
+{
+    const int ASTEROIDS = 6000;
+    const int FRAMES = 600;
+    const float dt = 1.0f / SIM_TICK_HZ;
+
+    worldWidth = 8000;
+    worldHeight = 8000;
+    Game start;
+    start.waveSize = ASTEROIDS;
+    start.invincible = true;
+    start.Reset();
+
+    View view = View::Follow({worldWidth / 2, worldHeight / 2});
+    view.halfW = worldWidth / 2;
+    view.halfH = worldHeight / 2;
+    std::vector<Vector2> vertices;
+    vertices.reserve((size_t)ASTEROIDS * 4 * ASTEROID_MAX_POINTS * 2);
+    size_t built = 0;
+
+    BotController bot;
+    Game serial = start;
+    double simTime = 0, renderTime = 0;
+    double t0 = NowSeconds();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        frameArena.Reset();
+        double a = NowSeconds();
+        serial.Update(dt, bot.Poll(serial));
+        double b = NowSeconds();
+        built += BuildFrameVertices(serial, view, vertices);
+        simTime += b - a;
+        renderTime += NowSeconds() - b;
+    }
+    double serialTime = NowSeconds() - t0;
+
+    SimThread threaded;
+    BotController simBot;
+    threaded.tickHz = 0;
+    threaded.controller = &simBot;
+    Game mirror = start;
+    threaded.Start(start);
+    double mirrorTime = 0;
+    t0 = NowSeconds();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        while (!threaded.frames.Acquire())
+            std::this_thread::yield();
+        double a = NowSeconds();
+        threaded.frames.Front().MoveInto(mirror);
+        mirrorTime += NowSeconds() - a;
+        built += BuildFrameVertices(mirror, view, vertices);
+    }
+    double threadedTime = NowSeconds() - t0;
+    threaded.Stop();
+
+    printf("threads: %d asteroids, %d frames, %u hardware threads\n", ASTEROIDS, FRAMES, std::thread::hardware_concurrency());
+    printf("  sim              %8.1f us/frame\n", simTime / FRAMES * 1e6);
+    printf("  render           %8.1f us/frame  (+%.1f us taking the frame when threaded)\n", renderTime / FRAMES * 1e6, mirrorTime / FRAMES * 1e6);
+    printf("  serial frame     %8.1f us\n", serialTime / FRAMES * 1e6);
+    printf("  threaded frame   %8.1f us  (%u sim ticks, %.2fx)\n", threadedTime / FRAMES * 1e6, threaded.ticks.load(), serialTime / threadedTime);
+    printf("  (%zu vertices built)\n", built);
+    return 0;
+}
+#endif
+
+// Stands in for a frame's CPU work.
+void SpinFor(double seconds)
+{
+    double end = NowSeconds() + seconds;
+    while (NowSeconds() < end)
+    {
+    }
+}
+
+// Paces 60 Hz frames of random 1-8 ms busy work. First the wait itself:
+// one sleep to the deadline (what SetTargetFPS does) against sleep-then-spin.
+// Then input age at present with an emulated vblank: vsync starts each frame
+// right after the last swap, latency mode as late as it dares.
+int BenchPacing()
+{
+    const int FRAMES = 120;
+    const double PERIOD = 1.0 / 60;
+    uint32_t rng = 12345;
+    auto work = [&] { return 0.001 + (NextRandom(rng) % 7000) * 1e-6; };
+
+    auto report = [](const char *label, const FrameStats &stats) {
+        printf("  %-14s interval %6.3f ms  stddev %6.3f ms  missed %d/%d\n", label, stats.Mean() * 1000,
+               stats.StdDev() * 1000, stats.Missed(), stats.count);
+    };
+
+    printf("pacing: %d frames at %.0f Hz, 1-8 ms of work each\n", FRAMES, 1 / PERIOD);
+
+    FrameStats sleepOnly;
+    double deadline = NowSeconds(), last = deadline;
+    for (int i = 0; i < FRAMES; i++)
+    {
+        SpinFor(work());
+        deadline += PERIOD;
+        if (deadline < NowSeconds())
+            deadline = NowSeconds();
+        std::this_thread::sleep_for(std::chrono::duration<double>(deadline - NowSeconds()));
+        double now = NowSeconds();
+        sleepOnly.Add(now - last, now - last > PERIOD * 1.5);
+        last = now;
+    }
+    report("sleep only", sleepOnly);
+
+    FramePacer hybrid;
+    hybrid.period = PERIOD;
+    for (int i = 0; i <= FRAMES; i++)
+    {
+        hybrid.BeginFrame();
+        SpinFor(work());
+        hybrid.Submit();
+        hybrid.Presented();
+    }
+    report("sleep + spin", hybrid.stats);
+    double sleepJitter = 0, hybridJitter = 0;
+    for (int i = 0; i < FRAMES; i++)
+    {
+        sleepJitter = std::max(sleepJitter, fabs(sleepOnly.interval[i] - PERIOD));
+        hybridJitter = std::max(hybridJitter, fabs(hybrid.stats.interval[i] - PERIOD));
+    }
+    printf("  worst deviation from %.3f ms: sleep only %.3f ms, sleep + spin %.3f ms\n", PERIOD * 1000,
+           sleepJitter * 1000, hybridJitter * 1000);
+
+    for (PaceMode mode : {PACE_VSYNC, PACE_LATENCY})
+    {
+        FramePacer pacer;
+        pacer.mode = mode;
+        pacer.period = PERIOD;
+        double origin = NowSeconds(), age = 0;
+        for (int i = 0; i <= FRAMES; i++)
+        {
+            pacer.BeginFrame();
+            double sampled = NowSeconds();
+            SpinFor(work());
+            pacer.Submit();
+            double vblank = origin + ceil((NowSeconds() - origin) / PERIOD) * PERIOD;
+            pacer.WaitUntil(vblank); // the swap
+            pacer.Presented();
+            if (i > 0)
+                age += NowSeconds() - sampled;
+        }
+        report(PACE_NAMES[mode], pacer.stats);
+        printf("  %-14s input age at present %6.3f ms\n", "", age / FRAMES * 1000);
+    }
+    return 0;
+}
+
+// Cost of EventLog::Emit on the simulation thread, in bursts of a quarter
+// ring so the writer keeps up, against writing each event straight to the
+// file. The log is then read back to check nothing was lost.
+int BenchEvents()
+{
+    const char *path = "zaydroids-bench-events.log";
+    const int BURST = (int)EVENT_QUEUE_SIZE / 4;
+    const int ROUNDS = 2000;
+    remove(path);
+
+    EventLog log;
+    if (!log.Open(path))
+    {
+        fprintf(stderr, "events: cannot write %s\n", path);
+        return 1;
+    }
+    double emitTime = 0;
+    double start = NowSeconds();
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        double t0 = NowSeconds();
+        for (int i = 0; i < BURST; i++)
+            log.Emit({round * 0.016 + i * 1e-6, {(float)i, (float)round}, round, (uint16_t)round, (uint8_t)(i % EVENT_KIND_COUNT), (uint8_t)i});
+        emitTime += NowSeconds() - t0;
+        while (log.queue.head.load(std::memory_order_acquire) != log.queue.tail.load(std::memory_order_relaxed))
+#ifdef ZAYDROIDS_THREADS
+            std::this_thread::yield();
+#else
+            log.Pump();
+#endif
+    }
+    log.Close();
+    double total = NowSeconds() - start;
+    uint64_t emitted = (uint64_t)BURST * ROUNDS;
+
+    std::vector<uint8_t> data;
+    if (FILE *f = fopen(path, "rb"))
+    {
+        uint8_t buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+            data.insert(data.end(), buf, buf + n);
+        fclose(f);
+    }
+    EventStats stats;
+    bool readBack = stats.Read(data.data(), data.size()) && stats.records == emitted - log.dropped;
+
+    // The synchronous alternative: encode and write each event on the spot.
+    const int SYNC = 20000;
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        fprintf(stderr, "events: cannot write %s\n", path);
+        return 1;
+    }
+    double t0 = NowSeconds();
+    for (int i = 0; i < SYNC; i++)
+    {
+        uint8_t buf[32];
+        ByteWriter w(buf, sizeof(buf));
+        WriteEvent(w, {i * 1e-3, {(float)i, 0}, i, 1, EVENT_SHOT, 0});
+        fwrite(buf, 1, w.len, f);
+        fflush(f);
+    }
+    double syncTime = NowSeconds() - t0;
+    fclose(f);
+    remove(path);
+
+    double perEvent = emitTime / emitted * 1e9;
+    printf("events: %llu in bursts of %d\n", (unsigned long long)emitted, BURST);
+    printf("  emit            %6.1f ns/event  (budget 20 ns)\n", perEvent);
+    printf("  write + fflush  %6.1f ns/event  (synchronous)\n", syncTime / SYNC * 1e9);
+    printf("  logged          %zu bytes in %.2f s, %u dropped\n", data.size(), total, log.dropped);
+    printf("  read back       %s (%llu records)\n", readBack ? "ok" : "MISMATCH", (unsigned long long)stats.records);
+    return perEvent < 20 && readBack ? 0 : 1;
+}
+
+#ifdef ZAYDROIDS_THREADS
+// Records 20 s of bot play as a replay, checks that playing the saved file
+// back ends in the same state, then times the software renderer over it at
+// 1, 2, 4, ... worker threads (no output written).
+int BenchRender()
+{
+    const double SECONDS = 20;
+    const char *path = "zaydroids-bench.zdr";
+
+    Replay replay;
+    Game recorded;
+    BotController bot;
+    replay.Begin(recorded, 12345);
+    for (double t = 0; t < SECONDS; t += 1.0 / SIM_TICK_HZ)
+    {
+        frameArena.Reset();
+        PlayerInput in = bot.Poll(recorded);
+        replay.Add(1.0f / SIM_TICK_HZ, in, recorded);
+        recorded.Update(1.0f / SIM_TICK_HZ, in);
+    }
+
+    Replay loaded;
+    bool saved = replay.Save(path) && loaded.Load(path);
+    remove(path);
+    Game played;
+    loaded.Start(played);
+    for (auto &tick : loaded.ticks)
+    {
+        frameArena.Reset();
+        played.Update(tick.dt, PlayerInput::FromBits(tick.input));
+    }
+    std::vector<uint8_t> a(recorded.SnapshotSize()), b(played.SnapshotSize());
+    bool same = saved && a.size() == b.size() && recorded.WriteSnapshot(a.data(), a.size()) &&
+                played.WriteSnapshot(b.data(), b.size()) && a == b;
+    printf("render: %.0f s replay, %zu ticks; playback %s (score %d, wave %d)\n", SECONDS, loaded.ticks.size(),
+           same ? "identical" : "DIFFERS", played.score, played.wave);
+
+    int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    for (int threads = 1;; threads = std::min(threads * 2, maxThreads))
+    {
+        double seconds = 0;
+        int frames = RenderVideo(nullptr, &loaded, 0, threads, &seconds);
+        printf("  %2d thread%s %7.3f ms/frame  %6.1fx realtime at %dx%d\n", threads, threads > 1 ? "s" : " ",
+               seconds / frames * 1000, frames / (double)VIDEO_FPS / seconds, SoftRenderer::WIDTH, SoftRenderer::HEIGHT);
+        if (threads == maxThreads)
+            break;
+    }
+    return same ? 0 : 1;
+}
+
+// Random seeks into an hour of recorded bot play, through the keyframes and
+// (for a few) from tick 0, plus a check that a seek lands on exactly the
+// state straight playback reaches.
+int BenchSeek()
+{
+    const double HOUR = 3600;
+    const int SEEKS = 200;
+    const char *path = "zaydroids-bench-seek.zdr";
+
+    Replay recorded;
+    Game game;
+    BotController bot;
+    recorded.Begin(game, 777);
+    double t0 = NowSeconds();
+    while (recorded.recordedTime < HOUR)
+    {
+        frameArena.Reset();
+        PlayerInput in = bot.Poll(game);
+        recorded.Add(1.0f / SIM_TICK_HZ, in, game);
+        game.Update(1.0f / SIM_TICK_HZ, in);
+    }
+    double recordTime = NowSeconds() - t0;
+
+    Replay replay;
+    bool loaded = recorded.Save(path) && replay.Load(path);
+    FILE *f = fopen(path, "rb");
+    long fileSize = 0;
+    if (f)
+    {
+        fseek(f, 0, SEEK_END);
+        fileSize = ftell(f);
+        fclose(f);
+    }
+    remove(path);
+    if (!loaded)
+    {
+        fprintf(stderr, "seek: replay did not survive save/load\n");
+        return 1;
+    }
+    printf("seek: %.0f s replay, %zu ticks, %zu keyframes, %ld bytes (simulated in %.2f s, %.0fx realtime)\n", HOUR,
+           replay.ticks.size(), replay.keyframes.size(), fileSize, recordTime, HOUR / recordTime);
+
+    uint32_t rng = 4242;
+    std::vector<double> latency;
+    ReplayPlayer player(replay);
+    for (int i = 0; i < SEEKS; i++)
+    {
+        size_t target = NextRandom(rng) % replay.ticks.size();
+        double a = NowSeconds();
+        player.Seek(target);
+        latency.push_back(NowSeconds() - a);
+    }
+    std::sort(latency.begin(), latency.end());
+    double sum = 0;
+    for (double l : latency)
+        sum += l;
+    printf("  keyframe seek   mean %6.2f ms  p50 %6.2f ms  p99 %6.2f ms  max %6.2f ms\n", sum / SEEKS * 1000,
+           latency[SEEKS / 2] * 1000, latency[SEEKS * 99 / 100] * 1000, latency.back() * 1000);
+
+    // Without keyframes a seek replays everything before the target.
+    Replay bare = replay;
+    bare.keyframes.clear();
+    ReplayPlayer slow(bare);
+    double slowSum = 0;
+    const int SLOW_SEEKS = 3;
+    for (int i = 0; i < SLOW_SEEKS; i++)
+    {
+        size_t target = NextRandom(rng) % replay.ticks.size();
+        slow.Seek(0);
+        double a = NowSeconds();
+        slow.Seek(target);
+        slowSum += NowSeconds() - a;
+        player.Seek(target);
+    }
+    printf("  from tick 0     mean %6.2f ms  (%d seeks)\n", slowSum / SLOW_SEEKS * 1000, SLOW_SEEKS);
+
+    // `slow` and `player` both ended on the last target, one by straight
+    // playback and one from a keyframe.
+    std::vector<uint8_t> a(slow.game.SnapshotSize()), b(player.game.SnapshotSize());
+    bool same = a.size() == b.size() && slow.game.WriteSnapshot(a.data(), a.size()) &&
+                player.game.WriteSnapshot(b.data(), b.size()) && a == b;
+    printf("  keyframe seek vs straight playback: %s\n", same ? "identical" : "DIFFERS");
+
+    // Fast-forward: render one frame in eight over the last minute.
+    double seconds = 0;
+    int frames = RenderVideo(nullptr, &replay, 0, (int)std::thread::hardware_concurrency(), &seconds, HOUR - 60, 8);
+    printf("  fast-forward x8 over the last minute: %d frames in %.2f s\n", frames, seconds);
+    return same ? 0 : 1;
+}
+#endif
+
+int RunBenchmark(const char *name)
+{
+    if (strcmp(name, "snapshot") == 0)
+        return BenchSnapshot();
+    if (strcmp(name, "lod") == 0)
+        return BenchLod();
+    if (strcmp(name, "allocs") == 0)
+        return BenchAllocs();
+    if (strcmp(name, "particles") == 0)
+        return BenchParticles();
+    if (strcmp(name, "fastmath") == 0)
+        return BenchFastMath();
+    if (strcmp(name, "bounce") == 0)
+        return BenchBounce();
+    if (strcmp(name, "slotmap") == 0)
+        return BenchSlotMap();
+    if (strcmp(name, "pacing") == 0)
+        return BenchPacing();
+    if (strcmp(name, "events") == 0)
+        return BenchEvents();
+#ifdef ZAYDROIDS_THREADS
+    if (strcmp(name, "threads") == 0)
+        return BenchThreads();
+    if (strcmp(name, "render") == 0)
+        return BenchRender();
+    if (strcmp(name, "seek") == 0)
+        return BenchSeek();
+#endif
+
+    fprintf(stderr, "unknown benchmark: %s\n", name);
+    return 1;
+}
+
+// --------------------------------------------------
+// Spectator server
+// --------------------------------------------------
+
+// The server runs the simulation headless at a fixed tick, with a bot at the
+// controls, and streams it to viewers over TCP. Every message is
+// [u32 length][u8 type][u32 tick][payload] where the payload is a full
+// snapshot (keyframe) or a delta against the previous tick. Each tick is
+// encoded once and the same buffer is queued on every connection.
+
+const int SERVER_TICK_HZ = 60;
+const int SERVER_DEFAULT_PORT = 7777;
+const size_t SERVER_MAX_QUEUED = 8;
+const float SERVER_RESTART_DELAY = 3.0f;
+
+const uint8_t STREAM_KEYFRAME = 0;
+const uint8_t STREAM_DELTA = 1;
+const size_t STREAM_HEADER_BYTES = 4 + 1 + 4;
+// Largest frame a viewer accepts: a snapshot of this many entities, or a
+// delta against one (which can take up to twice the bytes). Anything longer
+// is a broken or hostile peer, not a frame worth buffering for.
+const size_t STREAM_MAX_BULLETS = 1 << 10;
+const size_t STREAM_MAX_ASTEROIDS = 1 << 16;
+const size_t STREAM_MAX_FRAME_BYTES =
+    5 + 2 * (SNAPSHOT_HEADER_BYTES + STREAM_MAX_BULLETS * SNAPSHOT_BULLET_BYTES +
+             STREAM_MAX_ASTEROIDS * SNAPSHOT_ASTEROID_BYTES);
+
+typedef std::shared_ptr<const std::vector<uint8_t>> SharedBuffer;
+
+SharedBuffer MakeStreamMessage(uint8_t type, uint32_t tick, const uint8_t *payload, size_t len)
+{
+    auto msg = std::make_shared<std::vector<uint8_t>>(STREAM_HEADER_BYTES + len);
+    uint32_t frameLen = (uint32_t)(len + 5);
+    memcpy(msg->data(), &frameLen, 4);
+    (*msg)[4] = type;
+    memcpy(msg->data() + 5, &tick, 4);
+    memcpy(msg->data() + STREAM_HEADER_BYTES, payload, len);
+    return msg;
+}
+
+double ThreadCpuSeconds()
+{
+#ifdef ZAYDROIDS_NET
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+#ifdef ZAYDROIDS_NET
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+void SetNonBlocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+}
+
+struct StreamConnection
+{
+    int fd;
+    bool needsKeyframe = true;
+    std::deque<SharedBuffer> queue;
+    size_t offset = 0; // bytes of queue.front() already sent
+};
+
+struct GameServer
+{
+    Game game;
+    BotController bot;
+    int listenFd = -1;
+    int port = 0;
+    std::vector<StreamConnection> clients;
+    std::vector<uint8_t> prev, cur, delta;
+    size_t prevLen = 0;
+    uint32_t tick = 0;
+    float restartTimer = 0;
+    uint64_t bytesSent = 0;
+    double simCpu = 0;
+    double sendCpu = 0;
+
+    // Binds to 127.0.0.1. Port 0 picks a free port, stored in `port`.
+    bool Listen(int requestedPort)
+    {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd < 0)
+            return false;
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((uint16_t)requestedPort);
+        if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd, 1024) < 0)
+        {
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd, (sockaddr *)&addr, &len);
+        port = ntohs(addr.sin_port);
+        SetNonBlocking(listenFd);
+        return true;
+    }
+
+    void AcceptClients()
+    {
+        for (;;)
+        {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0)
+                break;
+            SetNonBlocking(fd);
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            StreamConnection c;
+            c.fd = fd;
+            clients.push_back(c);
+        }
+    }
+
+    // Advances the simulation one tick and streams the result.
+    void Step(float dt)
+    {
+        frameArena.Reset();
+        double c0 = ThreadCpuSeconds();
+
+        AcceptClients();
+
+        if (game.gameOver)
+        {
+            restartTimer += dt;
+            if (restartTimer >= SERVER_RESTART_DELAY)
+            {
+                restartTimer = 0;
+                game.Reset();
+            }
+        }
+        PlayerInput in = bot.Poll(game);
+        in.restart = false;
+        game.Update(dt, in);
+
+        size_t need = game.SnapshotSize();
+        if (cur.size() < need)
+        {
+            cur.resize(need);
+            delta.resize(need * 2 + 16);
+        }
+        size_t curLen = game.WriteSnapshot(cur.data(), cur.size());
+        size_t deltaLen = EncodeSnapshotDelta(prev.data(), prevLen, cur.data(), curLen, delta.data(), delta.size());
+        tick++;
+
+        double c1 = ThreadCpuSeconds();
+
+        Broadcast(curLen, deltaLen);
+        std::swap(prev, cur);
+        prevLen = curLen;
+
+        double c2 = ThreadCpuSeconds();
+        simCpu += c1 - c0;
+        sendCpu += c2 - c1;
+    }
+
+    void Broadcast(size_t curLen, size_t deltaLen)
+    {
+        SharedBuffer keyframe, deltaMsg;
+        for (auto &c : clients)
+        {
+            // A connection that fell behind loses its queued deltas and
+            // resyncs from a keyframe once its partial message is flushed.
+            if (c.queue.size() > SERVER_MAX_QUEUED)
+            {
+                c.queue.resize(c.offset > 0 ? 1 : 0);
+                c.needsKeyframe = true;
+            }
+
+            if (c.needsKeyframe)
+            {
+                if (!keyframe)
+                    keyframe = MakeStreamMessage(STREAM_KEYFRAME, tick, cur.data(), curLen);
+                c.queue.push_back(keyframe);
+                c.needsKeyframe = false;
+            }
+            else
+            {
+                if (!deltaMsg)
+                    deltaMsg = MakeStreamMessage(STREAM_DELTA, tick, delta.data(), deltaLen);
+                c.queue.push_back(deltaMsg);
+            }
+        }
+
+        for (auto &c : clients)
+        {
+            if (!Flush(c))
+            {
+                close(c.fd);
+                c.fd = -1;
+            }
+        }
+        clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                     [](const StreamConnection &c)
+                                     { return c.fd < 0; }),
+                      clients.end());
+    }
+
+    // Sends as much of the queue as the socket accepts. Returns false once
+    // the viewer has gone away.
+    bool Flush(StreamConnection &c)
+    {
+        while (!c.queue.empty())
+        {
+            const std::vector<uint8_t> &msg = *c.queue.front();
+            ssize_t n = send(c.fd, msg.data() + c.offset, msg.size() - c.offset, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0)
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            bytesSent += (uint64_t)n;
+            c.offset += (size_t)n;
+            if (c.offset < msg.size())
+                return true;
+            c.queue.pop_front();
+            c.offset = 0;
+        }
+        return true;
     }
 
-    void SpawnWave()
+    void Close()
     {
-        asteroids.clear();
-        int count = 3 + wave;
+        for (auto &c : clients)
+            close(c.fd);
+        clients.clear();
+        if (listenFd >= 0)
+            close(listenFd);
+        listenFd = -1;
+    }
+};
 
-        for (int i = 0; i < count; i++)
-        {
-            Vector2 pos;
-            do
-            {
-                pos = {RandomRange(0, SCREEN_WIDTH), RandomRange(0, SCREEN_HEIGHT)};
-            } while (CircleCollision(pos, 80, player.pos, 120));
+struct StreamViewer
+{
+    int fd = -1;
+    std::vector<uint8_t> inbox;
+    size_t inboxLen = 0;
+    std::vector<uint8_t> base, scratch;
+    size_t baseLen = 0;
+    bool haveBase = false;
+    uint32_t lastTick = 0;
+    uint64_t framesApplied = 0;
 
-            asteroids.emplace_back(pos, 3);
+    bool Connect(int port)
+    {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((uint16_t)port);
+        if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            close(fd);
+            fd = -1;
+            return false;
         }
+        SetNonBlocking(fd);
+        inbox.resize(64 * 1024);
+        return true;
     }
 
-    void Reset()
+    // Drains the socket and applies every complete message. When game is
+    // null the stream is decoded but not restored (used by the load test).
+    // Returns false once the server has closed the connection or sent
+    // something malformed; the caller then drops it.
+    bool Poll(Game *game)
     {
-        score = 0;
-        lives = LIVES_START;
-        wave = 1;
-        gameOver = false;
-        player.Reset();
-        bullets.clear();
-        SpawnWave();
+        for (;;)
+        {
+            if (inbox.size() - inboxLen < 16 * 1024)
+                inbox.resize(inbox.size() * 2);
+            ssize_t n = recv(fd, inbox.data() + inboxLen, inbox.size() - inboxLen, MSG_DONTWAIT);
+            if (n == 0)
+                return false;
+            if (n < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    return false;
+                break;
+            }
+            inboxLen += (size_t)n;
+        }
+
+        size_t at = 0;
+        while (inboxLen - at >= 4)
+        {
+            uint32_t frameLen;
+            memcpy(&frameLen, inbox.data() + at, 4);
+            if (frameLen < 5 || frameLen > STREAM_MAX_FRAME_BYTES)
+                return false;
+            if (inboxLen - at - 4 < frameLen)
+                break;
+            const uint8_t *msg = inbox.data() + at + 4;
+            uint32_t tick;
+            memcpy(&tick, msg + 1, 4);
+            if (!Apply(msg[0], tick, msg + 5, frameLen - 5, game))
+                return false;
+            at += 4 + frameLen;
+        }
+        memmove(inbox.data(), inbox.data() + at, inboxLen - at);
+        inboxLen -= at;
+        return true;
     }
 
-    void Update(float dt)
+    // False if the frame is a delta that doesn't decode against the base or
+    // decodes to a state the game refuses. There is no way to ask the server
+    // for a fresh keyframe, and deltas on top of a base the viewer never
+    // took would only compound the error.
+    bool Apply(uint8_t type, uint32_t tick, const uint8_t *payload, size_t len, Game *game)
     {
-        if (gameOver)
+        if (type == STREAM_KEYFRAME)
         {
-            if (IsKeyPressed(KEY_ENTER))
-                Reset();
-            return;
+            base.assign(payload, payload + len);
+            baseLen = len;
+            haveBase = true;
+        }
+        else if (type == STREAM_DELTA && haveBase)
+        {
+            if (scratch.size() < baseLen + len)
+                scratch.resize(baseLen + len);
+            size_t n = DecodeSnapshotDelta(base.data(), baseLen, payload, len, scratch.data(), scratch.size());
+            if (n == 0)
+            {
+                haveBase = false;
+                return false;
+            }
+            std::swap(base, scratch);
+            baseLen = n;
         }
+        else
+            return true;
 
-        player.Update(dt);
+        lastTick = tick;
+        framesApplied++;
+        if (game && !game->ReadSnapshot(base.data(), baseLen))
+        {
+            haveBase = false;
+            return false;
+        }
+        return true;
+    }
 
-        if ((IsKeyDown(KEY_SPACE) || IsMouseButtonDown(MOUSE_LEFT_BUTTON) || IsGestureDetected(GESTURE_TAP)) && player.CanShoot())
-            bullets.push_back(player.Shoot());
+    void Close()
+    {
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+    }
+};
 
-        for (auto &b : bullets)
-            b.Update(dt);
-        bullets.erase(std::remove_if(bullets.begin(), bullets.end(),
-                                     [](Bullet &b)
-                                     { return b.life <= 0; }),
-                      bullets.end());
+int RunServer(int port)
+{
+    GameServer server;
+    if (!server.Listen(port))
+    {
+        fprintf(stderr, "server: cannot listen on port %d\n", port);
+        return 1;
+    }
+    printf("server: streaming on 127.0.0.1:%d at %d Hz\n", server.port, SERVER_TICK_HZ);
 
-        for (auto &a : asteroids)
-            a.Update(dt);
+    using clock = std::chrono::steady_clock;
+    const auto tickLength = std::chrono::nanoseconds(1000000000 / SERVER_TICK_HZ);
+    auto next = clock::now();
+    for (;;)
+    {
+        server.Step(1.0f / SERVER_TICK_HZ);
+        next += tickLength;
+        std::this_thread::sleep_until(next);
+    }
+}
 
-        HandleCollisions();
+int RunViewer(int port)
+{
+    StreamViewer viewer;
+    if (!viewer.Connect(port))
+    {
+        fprintf(stderr, "viewer: cannot connect to 127.0.0.1:%d\n", port);
+        return 1;
+    }
 
-        if (asteroids.empty())
-        {
-            wave++;
-            player.invuln = 2.0f;
-            SpawnWave();
-        }
-        if (IsKeyPressed(KEY_F))
+    InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "ZayfireStudios - ZayDroids (spectator)");
+    SetTargetFPS(60);
+
+    Game view;
+    bool connected = true;
+    while (!WindowShouldClose())
+    {
+        if (connected && !viewer.Poll(&view))
         {
-#ifdef __EMSCRIPTEN__
-            emscripten_request_fullscreen("#canvas", EM_FALSE);
-#else
-            ToggleFullscreen();
-#endif
+            connected = false;
+            viewer.Close();
         }
+
+        BeginDrawing();
+        ClearBackground({10, 12, 20, 255});
+        if (viewer.haveBase)
+            view.Draw();
+        if (!connected)
+            DrawText("Disconnected", 20, SCREEN_HEIGHT - 40, 20, RED);
+        EndDrawing();
     }
 
-    void HandleCollisions()
+    viewer.Close();
+    CloseWindow();
+    return 0;
+}
+
+// Runs a server thread plus `viewers` in-process connections and reports how
+// much server CPU time each viewer costs on top of the simulation itself.
+int RunLoadTest(int viewers, float seconds)
+{
+    GameServer server;
+    if (!server.Listen(0))
     {
-        std::vector<Asteroid> newAsteroids;
+        fprintf(stderr, "loadtest: cannot listen\n");
+        return 1;
+    }
 
-        for (auto &a : asteroids)
+    std::vector<StreamViewer> clients(viewers);
+    for (auto &c : clients)
+    {
+        if (!c.Connect(server.port))
         {
-            bool hit = false;
-            for (auto &b : bullets)
-            {
-                if (CircleCollision(b.pos, 2, a.pos, a.radius))
-                {
-                    b.life = 0;
-                    hit = true;
-                    score += 10 * a.size;
-
-                    if (a.size > 1)
-                    {
-                        for (int i = 0; i < 2; i++)
-                            newAsteroids.emplace_back(a.pos, a.size - 1);
-                    }
-                    break;
-                }
-            }
+            fprintf(stderr, "loadtest: connect failed after %d viewers\n", (int)(&c - clients.data()));
+            return 1;
+        }
+    }
 
-            if (!hit)
-                newAsteroids.push_back(a);
+    std::atomic<bool> running{true};
+    double serverCpu = 0;
+    std::thread serverThread([&]
+                             {
+        using clock = std::chrono::steady_clock;
+        const auto tickLength = std::chrono::nanoseconds(1000000000 / SERVER_TICK_HZ);
+        double c0 = ThreadCpuSeconds();
+        auto next = clock::now();
+        while (running.load(std::memory_order_relaxed))
+        {
+            server.Step(1.0f / SERVER_TICK_HZ);
+            next += tickLength;
+            std::this_thread::sleep_until(next);
         }
+        serverCpu = ThreadCpuSeconds() - c0; });
 
-        asteroids = newAsteroids;
+    std::vector<pollfd> fds(viewers);
+    for (int i = 0; i < viewers; i++)
+        fds[i] = {clients[i].fd, POLLIN, 0};
 
-        if (player.invuln <= 0)
+    double end = NowSeconds() + seconds;
+    while (NowSeconds() < end)
+    {
+        if (poll(fds.data(), fds.size(), 50) <= 0)
+            continue;
+        for (int i = 0; i < viewers; i++)
         {
-            for (auto &a : asteroids)
+            if (fds[i].fd >= 0 && (fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
             {
-                if (CircleCollision(player.pos, SHIP_RADIUS, a.pos, a.radius))
+                if (!clients[i].Poll(nullptr))
                 {
-                    lives--;
-                    player.Reset();
-                    if (lives <= 0)
-                        gameOver = true;
-                    break;
+                    clients[i].Close();
+                    fds[i].fd = -1;
                 }
             }
         }
     }
 
-    void Draw() const
+    running = false;
+    serverThread.join();
+
+    uint64_t frames = 0;
+    int alive = 0;
+    for (auto &c : clients)
     {
-        for (auto &a : asteroids)
-            a.Draw();
-        for (auto &b : bullets)
-            b.Draw();
-        if (!gameOver || player.invuln > 0)
-            player.Draw();
+        frames += c.framesApplied;
+        alive += c.fd >= 0;
+        c.Close();
+    }
+    size_t connected = server.clients.size();
+    server.Close();
 
-        DrawText(TextFormat("Score: %d", score), 20, 20, 20, RAYWHITE);
-        DrawText(TextFormat("Lives: %d", lives), 20, 45, 20, RAYWHITE);
-        DrawText(TextFormat("Wave: %d", wave), 20, 70, 20, RAYWHITE);
+    double ticks = server.tick > 0 ? server.tick : 1;
+    double perViewer = viewers > 0 ? server.sendCpu / ticks / viewers : 0;
+    printf("loadtest: %d viewers, %.1f s, %u ticks\n", viewers, seconds, server.tick);
+    printf("  server cpu         %6.1f%% of one core\n", serverCpu / seconds * 100);
+    printf("  simulation         %8.2f us/tick\n", server.simCpu / ticks * 1e6);
+    printf("  fan-out            %8.2f us/tick  (%.3f us/tick per viewer)\n", server.sendCpu / ticks * 1e6, perViewer * 1e6);
+    printf("  sent               %8.1f KiB/s total\n", server.bytesSent / 1024.0 / seconds);
+    printf("  viewers connected  %d server-side, %d client-side\n", (int)connected, alive);
+    printf("  frames applied     %.1f per viewer per second\n", viewers > 0 ? frames / (double)viewers / seconds : 0);
+    return 0;
+}
 
-        if (gameOver)
-        {
-            const char *t = "GAME OVER";
-            const char *s = "Press ENTER to restart";
-            DrawText(t, SCREEN_WIDTH / 2 - MeasureText(t, 48) / 2, SCREEN_HEIGHT / 2 - 40, 48, RED);
-            DrawText(s, SCREEN_WIDTH / 2 - MeasureText(s, 20) / 2, SCREEN_HEIGHT / 2 + 20, 20, RAYWHITE);
-        }
-    }
-};
+#endif
 
 // --------------------------------------------------
 // Main
 // --------------------------------------------------
 Game game;
+ParticlePool particles;
+InputCapture inputCapture;
+// Serial mode's input; the sim thread has its own.
+InputQueue inputQueue;
+InputTimeline inputTimeline;
+#ifdef ZAYDROIDS_THREADS
+// When set, the game runs on this thread and `game` is a read-only mirror of
+// its latest published frame.
+SimThread *sim = nullptr;
+#endif
+
+bool showStats = false;
+bool serialSim = false;
+bool latencyMode = false;
+FramePacer pacer;
+EventLog eventLog;
+const char *eventLogPath = nullptr;
+Replay replay;
+const char *replayPath = nullptr;
+Replay *recording = nullptr; // set while --record is capturing
+
+// Input-to-present latency (--latency): from a press's timestamp to the
+// return of the EndDrawing that first shows a tick which consumed it.
+// Scan-out and panel delay come on top of this and are the same whichever
+// path delivered the input.
+struct LatencyStats
+{
+    int count = 0;
+    double sum = 0;
+    double max = 0;
+
+    void Add(double seconds)
+    {
+        count++;
+        sum += seconds;
+        max = std::max(max, seconds);
+    }
+
+    double Mean() const { return count ? sum / count : 0; }
+};
+LatencyStats inputLatency;
+double shownPress = 0; // press stamp waiting for its frame to be presented
+double drawTime = 0;
+uint64_t frameAllocations = 0;
+
+// Live performance overlay, toggled with F3 and always on in stress mode.
+// Phase timings are smoothed so they stay readable.
+void DrawStatsOverlay()
+{
+    static double update = 0, collide = 0, draw = 0, hudDraw = 0;
+    update = update * 0.9 + game.updateTime * 0.1;
+    collide = collide * 0.9 + game.collideTime * 0.1;
+    draw = draw * 0.9 + drawTime * 0.1;
+    hudDraw = hudDraw * 0.9 + hud.drawTime * 0.1;
+
+    int x = SCREEN_WIDTH - 220;
+    int y = 20;
+    DrawRectangle(x - 10, y - 8, 210, latencyMode ? 292 : 272, Fade(BLACK, 0.6f));
+    DrawText(TextFormat("FPS: %d", GetFPS()), x, y, 20, LIME);
+    DrawText(TextFormat("Asteroids: %d", (int)game.asteroids.size()), x, y + 25, 16, RAYWHITE);
+    DrawText(TextFormat("Bullets: %d", (int)game.bullets.size()), x, y + 45, 16, RAYWHITE);
+    DrawText(TextFormat("Drawn: %d", game.drawnCount), x, y + 65, 16, RAYWHITE);
+    DrawText(TextFormat("Update:  %.2f ms", update * 1000), x, y + 85, 16, RAYWHITE);
+    DrawText(TextFormat("Collide: %.2f ms", collide * 1000), x, y + 105, 16, RAYWHITE);
+    DrawText(TextFormat("Draw:    %.2f ms", draw * 1000), x, y + 125, 16, RAYWHITE);
+    DrawText(TextFormat("HUD:     %.3f ms %s", hudDraw * 1000, hud.cached ? "(cached)" : "(text)"), x, y + 145, 16, RAYWHITE);
+    DrawText(TextFormat("Particles: %.2f ms x%.2f", (particles.updateTime + particles.drawTime) * 1000, particles.scale), x, y + 165, 16,
+             particles.scale < 1 ? ORANGE : RAYWHITE);
+#ifdef ZAYDROIDS_COUNT_ALLOCS
+    DrawText(TextFormat("Heap allocs: %d", (int)frameAllocations), x, y + 185, 16, frameAllocations ? ORANGE : RAYWHITE);
+#else
+    DrawText("Heap allocs: n/a", x, y + 185, 16, GRAY);
+#endif
+#ifdef ZAYDROIDS_THREADS
+    DrawText(sim ? "Sim: own thread" : "Sim: serial", x, y + 205, 16, RAYWHITE);
+#else
+    DrawText("Sim: serial", x, y + 205, 16, RAYWHITE);
+#endif
+    DrawText(TextFormat("Pace: %s %.0f Hz", PACE_NAMES[pacer.mode], 1 / pacer.period), x, y + 225, 16, RAYWHITE);
+    int missed = pacer.stats.Missed();
+    DrawText(TextFormat("Frame: %.2f+-%.2f ms, %d late", pacer.stats.Mean() * 1000, pacer.stats.StdDev() * 1000, missed), x, y + 245, 16,
+             missed ? ORANGE : RAYWHITE);
+    if (latencyMode)
+        DrawText(TextFormat("Input: %.1f ms (max %.1f)", inputLatency.Mean() * 1000, inputLatency.max * 1000), x, y + 265, 16, SKYBLUE);
+}
+
+// Retained rendering: while nothing on screen can change (paused, or game
+// over once the last explosion has faded) the scene is drawn once into
+// sceneCache and presented from it with a single quad. After IDLE_GRACE
+// seconds without input in that state the loop also drops to IDLE_FPS, and
+// any input brings it straight back to ACTIVE_FPS.
+const int ACTIVE_FPS = 60;
+const int IDLE_FPS = 10;
+const double IDLE_GRACE = 0.5;
+
+bool paused = false;
+bool idle = false;
+bool sceneCached = false;
+RenderTexture2D sceneCache = {};
+double lastInputTime = 0;
+
+void SetFrameRate(int fps)
+{
+#ifdef __EMSCRIPTEN__
+    // The browser drives the loop from requestAnimationFrame; skip vsyncs
+    // instead of setting a timer.
+    emscripten_set_main_loop_timing(EM_TIMING_RAF, std::max(1, ACTIVE_FPS / fps));
+#else
+    pacer.minInterval = fps < ACTIVE_FPS ? 1.0 / fps : 0;
+#endif
+}
+
+// Pause when the window loses focus; off in stress mode so it can run in
+// the background.
+bool autoPause = true;
+bool resumeFrame = false;
+
+#ifdef __EMSCRIPTEN__
+// Browser key events, stamped as they are dispatched instead of at the
+// next frame's poll.
+EM_BOOL OnKey(int type, const EmscriptenKeyboardEvent *e, void *)
+{
+    inputCapture.Key(e->code, type == EMSCRIPTEN_EVENT_KEYDOWN, NowSeconds());
+    return EM_FALSE;
+}
+
+// A hidden tab runs no frames at all; the loop restarts with a zero-length
+// frame so the time spent hidden is not simulated.
+EM_BOOL OnVisibilityChange(int, const EmscriptenVisibilityChangeEvent *e, void *)
+{
+#ifdef ZAYDROIDS_THREADS
+    if (sim)
+        sim->paused = e->hidden || paused;
+#endif
+    if (e->hidden)
+        emscripten_pause_main_loop();
+    else
+    {
+        resumeFrame = true;
+        emscripten_resume_main_loop();
+    }
+    return EM_FALSE;
+}
+
+// Visible but unfocused: pause the game, which makes the scene static and
+// lets the retained path drop to IDLE_FPS.
+EM_BOOL OnBlur(int, const EmscriptenFocusEvent *, void *)
+{
+    if (autoPause && !game.gameOver)
+        paused = true;
+    return EM_FALSE;
+}
+#endif
+
+bool AnyInput()
+{
+    Vector2 d = GetMouseDelta();
+    return inputCapture.pressedCount > 0 || d.x != 0 || d.y != 0 ||
+           IsMouseButtonDown(MOUSE_LEFT_BUTTON) || GetTouchPointCount() > 0;
+}
+
+void DrawScene()
+{
+    ClearBackground({10, 12, 20, 255});
+    game.Draw();
+    if (paused)
+        hud.DrawPaused();
+}
 
 void UpdateDrawFrame()
 {
-    float dt = GetFrameTime();
+    frameArena.Reset();
+    uint64_t allocsBefore = HeapAllocations();
+    float dt = std::min(GetFrameTime(), MAX_FRAME_DT);
+    if (resumeFrame)
+    {
+        dt = 0;
+        resumeFrame = false;
+    }
+    if (autoPause && !paused && !game.gameOver && !IsWindowFocused())
+        paused = true;
+    pacer.BeginFrame();
+    inputCapture.Sample(NowSeconds(), false);
+
+    if (inputCapture.Pressed(KEY_F3))
+        showStats = !showStats;
+    if (inputCapture.Pressed(KEY_F4))
+    {
+        hud.cached = !hud.cached;
+        sceneCached = false;
+    }
+    if (inputCapture.Pressed(KEY_P) && !game.gameOver)
+        paused = !paused;
+    if (inputCapture.Pressed(KEY_F))
+    {
+#ifdef __EMSCRIPTEN__
+        emscripten_request_fullscreen("#canvas", EM_FALSE);
+#else
+        ToggleFullscreen();
+#endif
+        sceneCached = false;
+    }
+    if (AnyInput())
+        lastInputTime = GetTime();
+    inputCapture.ClearPressed();
+
+#ifdef ZAYDROIDS_THREADS
+    if (sim)
+    {
+        if (sim->frames.Acquire())
+        {
+            RenderFrame &frame = sim->frames.Front();
+            for (auto &e : frame.effects)
+                particles.Play(e);
+            if (shownPress == 0)
+                shownPress = frame.pressStamp;
+            frame.MoveInto(game);
+        }
+        sim->paused = paused;
+        if (!paused)
+            particles.Update(dt);
+    }
+    else
+#endif
+    if (!paused)
+    {
+        // Late sampling: poll again right before simulating, so input that
+        // arrived while the last frame was presented makes this tick.
+        PollInputEvents();
+        double now = NowSeconds();
+        inputCapture.Sample(now, true);
+        PlayerInput in = inputTimeline.Advance(inputQueue, now);
+        if (shownPress == 0)
+            shownPress = inputTimeline.pressStamp;
+        if (recording)
+            recording->Add(dt, in, game);
+        game.Update(dt, in);
+        particles.Update(dt);
+    }
+    else
+        inputTimeline.Advance(inputQueue, NowSeconds()); // keep held keys current
+
+    bool still = (paused || game.gameOver) && !particles.Active();
+    if (!still)
+        sceneCached = false;
+
+    bool wantIdle = still && GetTime() - lastInputTime > IDLE_GRACE;
+    if (wantIdle != idle)
+    {
+        idle = wantIdle;
+        SetFrameRate(idle ? IDLE_FPS : ACTIVE_FPS);
+    }
+
+    if (still && !sceneCached)
+    {
+        if (sceneCache.id == 0)
+            sceneCache = LoadRenderTexture(SCREEN_WIDTH, SCREEN_HEIGHT);
+        hud.Prepare(game.score, game.lives, game.wave);
+        BeginTextureMode(sceneCache);
+        DrawScene();
+        EndTextureMode();
+        sceneCached = true;
+    }
 
     BeginDrawing();
-    ClearBackground({10, 12, 20, 255});
 
-    game.Update(dt);
-    game.Draw();
+    double t0 = NowSeconds();
+    if (still)
+        DrawTextureRec(sceneCache.texture, {0, 0, (float)SCREEN_WIDTH, -(float)SCREEN_HEIGHT}, {0, 0}, WHITE);
+    else
+        DrawScene();
+    drawTime = NowSeconds() - t0;
+
+    if (showStats)
+        DrawStatsOverlay();
 
+    pacer.Submit();
     EndDrawing();
+    pacer.Presented();
+    if (shownPress != 0)
+    {
+        inputLatency.Add(NowSeconds() - shownPress);
+        shownPress = 0;
+    }
+    frameAllocations = HeapAllocations() - allocsBefore;
+#ifndef ZAYDROIDS_THREADS
+    if (eventLog.file)
+        eventLog.Pump();
+#endif
 }
 
-int main()
+int main(int argc, char **argv)
 {
+    SeedRandom((uint32_t)time(nullptr));
+
+    // Global options may appear anywhere; strip them before picking a mode.
+    int kept = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--lod") == 0)
+            game.simLod = true;
+        else if (strcmp(argv[i], "--bounce") == 0)
+            game.bounce = true;
+        else if (strcmp(argv[i], "--serial") == 0)
+            serialSim = true;
+        else if (strcmp(argv[i], "--latency") == 0)
+            latencyMode = showStats = true;
+        else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc)
+            eventLogPath = argv[++i];
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (strcmp(argv[i], "--pace") == 0 && i + 1 < argc)
+        {
+            const char *mode = argv[++i];
+            if (strcmp(mode, "uncapped") == 0)
+                pacer.mode = PACE_UNCAPPED;
+            else if (strcmp(mode, "vsync") == 0)
+                pacer.mode = PACE_VSYNC;
+            else if (strcmp(mode, "latency") == 0)
+                pacer.mode = PACE_LATENCY;
+            else if (atof(mode) > 0)
+            {
+                pacer.mode = PACE_TARGET;
+                pacer.period = 1 / atof(mode);
+            }
+        }
+        else if (strcmp(argv[i], "--world") == 0 && i + 1 < argc)
+        {
+            float w, h;
+            if (sscanf(argv[++i], "%fx%f", &w, &h) == 2 && w > 0 && h > 0)
+            {
+                worldWidth = w;
+                worldHeight = h;
+            }
+        }
+        else
+            argv[kept++] = argv[i];
+    }
+    argc = kept;
+    game.Reset();
+    game.effects = &particles;
+
+    if (argc > 2 && strcmp(argv[1], "--bench") == 0)
+        return RunBenchmark(argv[2]);
+
+#ifdef ZAYDROIDS_MMAP
+    if (argc > 2 && strcmp(argv[1], "--events") == 0)
+        return RunEventReport(argv[2]);
+#endif
+
+#ifdef ZAYDROIDS_THREADS
+    // Offline video: `--render out.y4m replay.zdr [--from SECONDS] [--speed
+    // N]` or `--render out.y4m --bot SECONDS`; "-" writes to stdout for
+    // piping into an encoder.
+    if (argc > 3 && strcmp(argv[1], "--render") == 0)
+    {
+        bool bot = strcmp(argv[3], "--bot") == 0;
+        if (!bot && !replay.Load(argv[3]))
+        {
+            fprintf(stderr, "render: cannot read replay %s\n", argv[3]);
+            return 1;
+        }
+        double from = 0;
+        int speed = 1;
+        for (int i = 4; i + 1 < argc; i++)
+        {
+            if (strcmp(argv[i], "--from") == 0)
+                from = atof(argv[++i]);
+            else if (strcmp(argv[i], "--speed") == 0)
+                speed = std::max(1, atoi(argv[++i]));
+        }
+        double seconds = 0;
+        int frames = RenderVideo(argv[2], bot ? nullptr : &replay, bot && argc > 4 ? atof(argv[4]) : 30,
+                                 (int)std::thread::hardware_concurrency(), &seconds, from, speed);
+        if (frames < 0)
+        {
+            fprintf(stderr, "render: cannot write %s\n", argv[2]);
+            return 1;
+        }
+        fprintf(stderr, "render: %d frames in %.2f s (%.1fx realtime)\n", frames, seconds,
+                frames / (double)VIDEO_FPS / seconds);
+        return 0;
+    }
+#endif
+
+    if (argc > 1 && strcmp(argv[1], "--fuzz") == 0)
+        return RunFuzz(argc > 2 ? argv[2] : "sorted", argc > 3 ? atoll(argv[3]) : 1000000,
+                       argc > 4 ? (uint32_t)strtoul(argv[4], nullptr, 10) : 1);
+
+    if (argc > 1 && strcmp(argv[1], "--soak") == 0)
+    {
+        EventLog *log = eventLogPath && eventLog.Open(eventLogPath) ? &eventLog : nullptr;
+        int result = RunSoak(argc > 2 ? atoi(argv[2]) : 1000, argc > 3 ? atoi(argv[3]) : 5000, log);
+        eventLog.Close();
+        if (eventLog.dropped)
+            fprintf(stderr, "event log: %u events dropped\n", eventLog.dropped);
+        return result;
+    }
+
+#ifdef ZAYDROIDS_NET
+    if (argc > 1 && strcmp(argv[1], "--server") == 0)
+        return RunServer(argc > 2 ? atoi(argv[2]) : SERVER_DEFAULT_PORT);
+    if (argc > 1 && strcmp(argv[1], "--connect") == 0)
+        return RunViewer(argc > 2 ? atoi(argv[2]) : SERVER_DEFAULT_PORT);
+    if (argc > 1 && strcmp(argv[1], "--loadtest") == 0)
+        return RunLoadTest(argc > 2 ? atoi(argv[2]) : 200, argc > 3 ? (float)atof(argv[3]) : 10.0f);
+#endif
+
+    // Scaling torture test: every wave is `count` asteroids and the ship
+    // can't die.
+    if (argc > 1 && strcmp(argv[1], "--stress") == 0)
+    {
+        game.waveSize = argc > 2 ? atoi(argv[2]) : 2000;
+        game.invincible = true;
+        game.Reset();
+        showStats = true;
+        autoPause = false;
+    }
+
+    if (eventLogPath)
+    {
+        if (eventLog.Open(eventLogPath))
+        {
+            game.eventLog = &eventLog;
+            game.Reset(); // logs the start of the first match
+        }
+        else
+            fprintf(stderr, "cannot open event log %s\n", eventLogPath);
+    }
+    if (replayPath)
+    {
+        replay.Begin(game, (uint32_t)time(nullptr));
+        recording = &replay;
+    }
+
     InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "ZayfireStudios - ZayDroids");
-    SetTargetFPS(60);
-    srand((unsigned)time(nullptr));
+
+#ifdef __EMSCRIPTEN__
+    // requestAnimationFrame already paces to the display; only measure.
+    pacer.mode = PACE_VSYNC;
+#else
+    // raylib's own limiter is off; the pacer decides when frames go out.
+    SetTargetFPS(0);
+    if (pacer.UsesVsync())
+    {
+        SetWindowState(FLAG_VSYNC_HINT);
+        int hz = GetMonitorRefreshRate(GetCurrentMonitor());
+        if (hz > 0)
+            pacer.period = 1.0 / hz;
+    }
+#endif
 
 #if defined(PLATFORM_WEB)
     bool rlDisableVao = true; // Force raylib to skip VAO calls
@@ -460,6 +6164,31 @@ int main()
     UnloadImage(icon);
 #endif
 
+#ifdef __EMSCRIPTEN__
+    emscripten_set_visibilitychange_callback(nullptr, EM_FALSE, OnVisibilityChange);
+    emscripten_set_blur_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW, nullptr, EM_FALSE, OnBlur);
+    emscripten_set_keydown_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW, nullptr, EM_FALSE, OnKey);
+    emscripten_set_keyup_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW, nullptr, EM_FALSE, OnKey);
+#endif
+
+#ifdef ZAYDROIDS_THREADS
+    // The simulation gets its own thread unless --serial is given, so a
+    // frame costs max(update, draw) rather than the sum. On the web this
+    // needs the threaded build (emcc -pthread -sPTHREAD_POOL_SIZE=1, served
+    // with the COOP/COEP headers in .htaccess); the browser main thread then
+    // only renders, so page script and GC pauses can't stall the simulation.
+    static SimThread simThread;
+    if (!serialSim)
+    {
+        simThread.recording = recording;
+        simThread.Start(game);
+        sim = &simThread;
+    }
+    inputCapture.queue = sim ? &simThread.input : &inputQueue;
+#else
+    inputCapture.queue = &inputQueue;
+#endif
+
 #if defined(PLATFORM_WEB)
     emscripten_set_main_loop(UpdateDrawFrame, 0, 1);
 #else
@@ -467,6 +6196,23 @@ int main()
     {
         UpdateDrawFrame();
     }
+#ifdef ZAYDROIDS_THREADS
+    simThread.Stop();
+#endif
+    eventLog.Close();
+    if (eventLog.dropped)
+        fprintf(stderr, "event log: %u events dropped\n", eventLog.dropped);
+    if (recording && !recording->Save(replayPath))
+        fprintf(stderr, "cannot write replay %s\n", replayPath);
+    if (latencyMode)
+    {
+        printf("frame pacing (%s): last %d frames %.2f ms mean, %.3f ms stddev, %d late\n", PACE_NAMES[pacer.mode],
+               pacer.stats.count, pacer.stats.Mean() * 1000, pacer.stats.StdDev() * 1000, pacer.stats.Missed());
+        printf("input latency: %d presses shown, mean %.2f ms, max %.2f ms (press to present)\n",
+               inputLatency.count, inputLatency.Mean() * 1000, inputLatency.max * 1000);
+        printf("  %d of %d presses caught by the late poll, one frame earlier than a frame-start poll\n",
+               inputCapture.latePresses, inputCapture.presses);
+    }
     CloseWindow();
 #endif
 